@@ -0,0 +1,279 @@
+#include "alloc.hpp"
+#include "team.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace ipc {
+
+static inline constexpr size_t allocSizes[] = {16, 64, 256, 1 << 10, 1 << 12, 1 << 15, 1 << 18};
+static inline constexpr size_t allocIterationCount = 1 << 4;
+// Live allocations per thread are bounded by both
+static inline constexpr size_t allocMaxBatchSize = 1 << 8;
+static inline constexpr size_t allocMaxLiveBytes = 1 << 22;
+// Pairs per sample and per thread: fewer for large sizes, which mostly go to the OS
+static inline constexpr size_t allocBytesPerSample = 1 << 26;
+static inline constexpr size_t allocMinPairCount = 1 << 9;
+static inline constexpr size_t allocMaxPairCount = 1 << 13;
+static inline constexpr size_t allocMaxThreadCount = 16;
+
+enum class AllocPattern {
+	Lifo,
+	Fifo,
+	Random,
+	// Each thread frees the batch of its neighbor
+	CrossThread
+};
+
+static const char* toString(AllocPattern pattern) {
+	switch (pattern) {
+	case AllocPattern::Lifo:
+		return "LIFO";
+	case AllocPattern::Fifo:
+		return "FIFO";
+	case AllocPattern::Random:
+		return "Random";
+	case AllocPattern::CrossThread:
+		return "Cross-thread";
+	}
+	return "Unknown";
+}
+
+struct MallocApi {
+	static inline constexpr auto name = "malloc/free";
+
+	static void* allocate(size_t size) {
+		auto res = std::malloc(size);
+		if (res == nullptr) {
+			std::stringstream ss;
+			ss << "ipc::MallocApi::allocate: Could not allocate " << size << " bytes";
+			throw std::runtime_error(ss.str());
+		}
+		return res;
+	}
+
+	static void release(void *ptr) {
+		std::free(ptr);
+	}
+};
+
+struct NewApi {
+	static inline constexpr auto name = "new/delete";
+
+	static void* allocate(size_t size) {
+		return ::operator new(size);
+	}
+
+	static void release(void *ptr) {
+		::operator delete(ptr);
+	}
+};
+
+struct AllocWorker {
+	// Two batches: with cross-thread frees, one can be in the hands of the neighbor while the next one is filled
+	std::vector<void*> batches[2];
+	std::vector<size_t> freeOrder;
+	// TSC ticks per single allocation and free, of timed passes only
+	std::vector<uint64_t> allocTicks;
+	std::vector<uint64_t> freeTicks;
+	// Batch handed to the next worker, null once it has been freed
+	alignas(64) std::atomic<void**> mailbox{nullptr};
+};
+
+// Smallest cost of reading the TSC twice, taken off every single timing
+static uint64_t getTscOverhead(void) {
+	auto res = UINT64_MAX;
+	for (size_t i = 0; i < 1 << 10; i++) {
+		auto begin = getTscTimestamp();
+		auto end = getTscTimestamp();
+		res = std::min<uint64_t>(res, end - begin);
+	}
+	return res;
+}
+
+// ticks: sorted
+static Duration getAllocPercentile(const std::vector<uint64_t> &ticks, double percentile, double cyclesPerTick, double frequency) {
+	auto index = std::min(static_cast<size_t>(percentile / 100.0 * static_cast<double>(ticks.size())), ticks.size() - 1);
+	auto cycles = static_cast<double>(ticks[index]) * cyclesPerTick;
+	return Duration{
+		.lengthCycles = cycles,
+		.lengthSeconds = cycles / frequency
+	};
+}
+
+template <typename Api>
+static void benchmarkAllocCase(const DurationMeasurer &durationMeasurer, const Report &report, AllocPattern pattern, size_t size, size_t threadCount, uint64_t tscOverhead) {
+	auto batchSize = std::clamp<size_t>(allocMaxLiveBytes / size, 16, allocMaxBatchSize);
+	auto pairCount = std::clamp<size_t>(allocBytesPerSample / size, allocMinPairCount, allocMaxPairCount);
+	auto roundCount = std::max<size_t>(pairCount / batchSize, 1);
+	pairCount = roundCount * batchSize;
+
+	// Set up outside of any measurement: the allocator under test must only see the benchmark's own calls
+	std::vector<std::unique_ptr<AllocWorker>> workers;
+	for (size_t i = 0; i < threadCount; i++) {
+		auto worker = std::make_unique<AllocWorker>();
+		for (auto &batch : worker->batches)
+			batch.resize(batchSize);
+		worker->freeOrder.resize(batchSize);
+		for (size_t j = 0; j < batchSize; j++)
+			worker->freeOrder[j] = pattern == AllocPattern::Lifo ? batchSize - 1 - j : j;
+		if (pattern == AllocPattern::Random)
+			std::shuffle(worker->freeOrder.begin(), worker->freeOrder.end(), std::mt19937_64(0xA110C + i));
+		worker->allocTicks.reserve(pairCount * allocIterationCount);
+		worker->freeTicks.reserve(pairCount * allocIterationCount);
+		workers.emplace_back(std::move(worker));
+	}
+
+	// Timed passes read the TSC around every call, which would dwarf the calls themselves in the throughput samples
+	bool timed = false;
+	std::function<void (size_t worker)> work = [&](size_t index) {
+		auto &worker = *workers[index];
+		auto &previous = *workers[(index + threadCount - 1) % threadCount];
+		for (size_t r = 0; r < roundCount; r++) {
+			auto &batch = worker.batches[r % 2];
+			for (size_t i = 0; i < batchSize; i++) {
+				void *ptr;
+				if (timed) {
+					auto begin = getTscTimestamp();
+					ptr = Api::allocate(size);
+					worker.allocTicks.emplace_back(getTscTimestamp() - begin);
+				} else
+					ptr = Api::allocate(size);
+				// Touched like any real allocation, which also keeps the pair from being elided
+				*static_cast<volatile char*>(ptr) = 1;
+				batch[i] = ptr;
+			}
+
+			auto release = [&](void *ptr) {
+				if (timed) {
+					auto begin = getTscTimestamp();
+					Api::release(ptr);
+					worker.freeTicks.emplace_back(getTscTimestamp() - begin);
+				} else
+					Api::release(ptr);
+			};
+			if (pattern == AllocPattern::CrossThread) {
+				while (worker.mailbox.load(std::memory_order_acquire) != nullptr)
+					std::this_thread::yield();
+				worker.mailbox.store(batch.data(), std::memory_order_release);
+				void **taken;
+				while ((taken = previous.mailbox.load(std::memory_order_acquire)) == nullptr)
+					std::this_thread::yield();
+				for (size_t i = 0; i < batchSize; i++)
+					release(taken[i]);
+				previous.mailbox.store(nullptr, std::memory_order_release);
+			} else {
+				for (auto i : worker.freeOrder)
+					release(batch[i]);
+			}
+		}
+	};
+
+	ThreadTeam team(threadCount);
+	// Once every worker went through a run: their stacks and TLS are not the allocator's
+	team.run([](size_t) {});
+	auto rssBefore = getResidentSetSize();
+	// First touches and allocator start-up belong to no sample
+	team.run(work);
+
+	double cycleSum = 0.0, tickSum = 0.0;
+	auto stats = sampleDurations(allocIterationCount, [&]() {
+		uint64_t ticks = 0;
+		auto res = durationMeasurer.measure([&]() {
+			auto begin = getTscTimestamp();
+			team.run(work);
+			ticks = getTscTimestamp() - begin;
+		});
+		cycleSum += res.lengthCycles;
+		tickSum += static_cast<double>(ticks);
+		return res;
+	}, false) / pairCount;
+	// Before the timed passes, whose tick buffers are not the allocator's
+	auto rssAfter = getResidentSetSize();
+
+	timed = true;
+	for (size_t i = 0; i < allocIterationCount; i++)
+		team.run(work);
+
+	std::vector<uint64_t> allocTicks, freeTicks;
+	for (auto &worker : workers) {
+		for (auto tick : worker->allocTicks)
+			allocTicks.emplace_back(tick > tscOverhead ? tick - tscOverhead : 0);
+		for (auto tick : worker->freeTicks)
+			freeTicks.emplace_back(tick > tscOverhead ? tick - tscOverhead : 0);
+	}
+	std::sort(allocTicks.begin(), allocTicks.end());
+	std::sort(freeTicks.begin(), freeTicks.end());
+	auto cyclesPerTick = tickSum > 0.0 ? cycleSum / tickSum : 1.0;
+	auto frequency = stats.mean.inferredFrequency();
+
+	std::stringstream op, execution;
+	op << Api::name << " " << size << " B " << toString(pattern);
+	execution << threadCount << (threadCount == 1 ? " thread" : " threads");
+
+	struct Tail {
+		const char *name;
+		Duration duration;
+	};
+	Tail tails[] = {
+		{"alloc p99", getAllocPercentile(allocTicks, 99.0, cyclesPerTick, frequency)},
+		{"alloc p99.9", getAllocPercentile(allocTicks, 99.9, cyclesPerTick, frequency)},
+		{"free p99", getAllocPercentile(freeTicks, 99.0, cyclesPerTick, frequency)},
+		{"free p99.9", getAllocPercentile(freeTicks, 99.9, cyclesPerTick, frequency)}
+	};
+	// What the allocator kept from the OS once everything was freed
+	auto rssGrowth = rssAfter > rssBefore ? rssAfter - rssBefore : 0;
+
+	std::printf("%s, Op = %s, %s: avg = %g cycles per pair, alloc p99 = %g, p99.9 = %g, free p99 = %g, p99.9 = %g cycles, RSS growth = %zu bytes (%g MHz)\n", report.meta, op.str().c_str(), execution.str().c_str(),
+		stats.mean.lengthCycles, tails[0].duration.lengthCycles, tails[1].duration.lengthCycles, tails[2].duration.lengthCycles, tails[3].duration.lengthCycles, rssGrowth, stats.mean.inferredFrequencyMHz());
+	report.writeRow(op.str(), execution.str(), size, stats);
+	for (auto &tail : tails)
+		report.writeRow(op.str(), execution.str() + " " + tail.name, size, tail.duration);
+	report.writeFigure(op.str(), execution.str() + " RSS growth", size, static_cast<double>(rssGrowth), "byte");
+}
+
+template <typename Api>
+static void benchmarkAllocApi(const DurationMeasurer &durationMeasurer, const Report &report, const std::vector<size_t> &threadCounts, uint64_t tscOverhead) {
+	for (auto pattern : {AllocPattern::Lifo, AllocPattern::Fifo, AllocPattern::Random, AllocPattern::CrossThread}) {
+		for (auto size : allocSizes) {
+			for (auto threadCount : threadCounts) {
+				if (pattern == AllocPattern::CrossThread && threadCount < 2)
+					continue;
+				benchmarkAllocCase<Api>(durationMeasurer, report, pattern, size, threadCount, tscOverhead);
+			}
+		}
+		std::printf("\n");
+	}
+}
+
+void benchmarkAlloc(const DurationMeasurer &durationMeasurer, const Report &baseReport, const AllocOptions &options) {
+	// Fields must not contain commas
+	std::string meta = baseReport.meta;
+	auto preload = std::getenv("LD_PRELOAD");
+	meta += std::string("; Allocator = ") + (preload != nullptr && *preload != '\0' ? preload : "default");
+	std::replace(meta.begin(), meta.end(), ',', ';');
+	auto report = baseReport.withMeta(meta.c_str());
+	std::printf("%s\n\n", meta.c_str());
+
+	auto maxThreadCount = options.maxThreadCount != 0 ? options.maxThreadCount : std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1), allocMaxThreadCount);
+	std::vector<size_t> threadCounts;
+	for (size_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+		threadCounts.emplace_back(threadCount);
+	threadCounts.emplace_back(maxThreadCount);
+	// Cross-thread frees need a second thread, even on a single core
+	if (maxThreadCount == 1)
+		threadCounts.emplace_back(2);
+
+	auto tscOverhead = getTscOverhead();
+	benchmarkAllocApi<MallocApi>(durationMeasurer, report, threadCounts, tscOverhead);
+	benchmarkAllocApi<NewApi>(durationMeasurer, report, threadCounts, tscOverhead);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+struct AllocOptions {
+	// Thread counts go 1, 2, 4.. up to this one. 0 is every logical processor, at most 16
+	size_t maxThreadCount = 0;
+};
+
+// malloc/free and new/delete across size classes, freeing in LIFO, FIFO and random order, or from another thread
+// Rows are cycles per allocation and free pair of each thread, with p99 and p99.9 of single allocations and frees, and the resident set growth left behind
+// Whatever allocator the process resolves is measured: run under LD_PRELOAD to measure another one, it is then recorded in the meta column
+void benchmarkAlloc(const DurationMeasurer &durationMeasurer, const Report &report, const AllocOptions &options);
+
+}
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <sstream>
 #include <cstring>
 #include "clock.hpp"
+#include "sampling.hpp"
 
 namespace ipc {
 
@@ -112,7 +113,7 @@ static consteval size_t getRepeatCount(void) {
 // Op is `T (T a, T b)`
 // srcBuffer contains the data to be processed in parallel: packs of [T a, T b, T res, T padding]
 template <typename T, size_t BufferSize, typename Op>
-Duration computeCyleCountPerOpPipelined(const ipc::DurationMeasurer &durationMeasurer, const Buffer &srcBuffer, Buffer &buffer, Op &&op) {
+Statistics computeCyleCountPerOpPipelined(const ipc::DurationMeasurer &durationMeasurer, const Buffer &srcBuffer, Buffer &buffer, Op &&op) {
 	assertBufferSizeAtLeast(srcBuffer, BufferSize);
 	assertBufferSize(srcBuffer, buffer.size);
 	assertBufferSizeMultipleOf(srcBuffer, sizeof(T) * 4);
@@ -140,22 +141,14 @@ Duration computeCyleCountPerOpPipelined(const ipc::DurationMeasurer &durationMea
 		});
 	};
 
-	Duration durations[cycleCountIterationCount];
-	for (size_t inst = 0; inst < cycleCountIterationCount; inst++) {
-		// Warmup
-		durations[inst] = sample();
-		// Actual
-		durations[inst] = sample();
-	}
-
-	auto avgOpDuration = Duration::average(durations) / (opCount * repeatCount);
-	return avgOpDuration;
+	auto perOpStats = sampleDurations(cycleCountIterationCount, sample) / (opCount * repeatCount);
+	return perOpStats;
 }
 
 // Op is `T (T a, T b)`
 // srcBuffer contains the data to be processed serially: packs of [T first, T accumulated0, T accumulated1, ..., T res]
 template <typename T, size_t BufferSize, typename Op>
-Duration computeCyleCountPerOpSequentially(const ipc::DurationMeasurer &durationMeasurer, const Buffer &srcBuffer, Buffer &buffer, Op &&op) {
+Statistics computeCyleCountPerOpSequentially(const ipc::DurationMeasurer &durationMeasurer, const Buffer &srcBuffer, Buffer &buffer, Op &&op) {
 	assertBufferSizeAtLeast(srcBuffer, BufferSize);
 	assertBufferSize(srcBuffer, buffer.size);
 	assertBufferSizeMultipleOf(srcBuffer, sizeof(T) * 4);
@@ -188,16 +181,8 @@ Duration computeCyleCountPerOpSequentially(const ipc::DurationMeasurer &duration
 		});
 	};
 
-	Duration durations[cycleCountIterationCount];
-	for (size_t inst = 0; inst < cycleCountIterationCount; inst++) {
-		// Warmup
-		durations[inst] = sample();
-		// Actual
-		durations[inst] = sample();
-	}
-
-	auto avgOpDuration = Duration::average(durations) / (opCount * repeatCount);
-	return avgOpDuration;
+	auto perOpStats = sampleDurations(cycleCountIterationCount, sample) / (opCount * repeatCount);
+	return perOpStats;
 }
 
 }
\ No newline at end of file
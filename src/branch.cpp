@@ -0,0 +1,217 @@
+#include "branch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace ipc {
+
+// One byte per branch: pattern periods in bytes are periods in branches
+static inline constexpr size_t branchCount = 1 << 17;
+static inline constexpr size_t branchIterationCount = 1 << 6;
+static inline constexpr size_t indirectTargetCount = 64;
+// A period is considered captured by the predictor while its misprediction rate stays under this
+static inline constexpr double capturedMispredictionRate = 0.05;
+
+static volatile size_t branchSink;
+
+template <size_t I>
+[[gnu::noinline]] static size_t indirectTarget(size_t acc) {
+	return acc * 3 + I;
+}
+
+template <size_t... Is>
+static constexpr std::array<size_t (*)(size_t), sizeof...(Is)> makeIndirectTargets(std::index_sequence<Is...>) {
+	return {indirectTarget<Is>...};
+}
+
+static constexpr auto indirectTargets = makeIndirectTargets(std::make_index_sequence<indirectTargetCount>());
+
+template <typename Fn>
+static Statistics sampleBranches(const DurationMeasurer &durationMeasurer, Fn &&fn) {
+	// Warmup also trains the predictor
+	return sampleDurations(branchIterationCount, [&]() {
+		return durationMeasurer.measure(fn);
+	}) / branchCount;
+}
+
+// outcomes: one byte per branch, non-zero is taken
+static Statistics measureConditional(const DurationMeasurer &durationMeasurer, const Buffer &outcomes) {
+	assertBufferSize(outcomes, branchCount);
+
+	return sampleBranches(durationMeasurer, [&]() {
+		auto taken = reinterpret_cast<const uint8_t*>(outcomes.data);
+		size_t acc = 0;
+		for (size_t i = 0; i < branchCount; i++) {
+			if (taken[i]) {
+				acc += i;
+				// Opaque to the optimizer: keeps the branch from being turned into a conditional move
+				asm volatile("" : "+r"(acc));
+			} else
+				acc ^= i;
+		}
+		branchSink = acc;
+	});
+}
+
+// selectors: one byte per indirect call, index into indirectTargets
+static Statistics measureIndirect(const DurationMeasurer &durationMeasurer, const Buffer &selectors) {
+	assertBufferSize(selectors, branchCount);
+
+	return sampleBranches(durationMeasurer, [&]() {
+		auto selected = reinterpret_cast<const uint8_t*>(selectors.data);
+		size_t acc = 0;
+		for (size_t i = 0; i < branchCount; i++)
+			acc = indirectTargets[selected[i]](acc);
+		branchSink = acc;
+	});
+}
+
+static double binaryEntropy(double p) {
+	if (p <= 0.0 || p >= 1.0)
+		return 0.0;
+	return -p * std::log2(p) - (1.0 - p) * std::log2(1.0 - p);
+}
+
+// Taken probability in [0, 0.5] whose binary entropy is the requested amount of bits
+static double takenProbabilityForEntropy(double entropyBits) {
+	double lo = 0.0, hi = 0.5;
+	for (size_t i = 0; i < 64; i++) {
+		auto mid = (lo + hi) / 2.0;
+		if (binaryEntropy(mid) < entropyBits)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return (lo + hi) / 2.0;
+}
+
+static void writeAlwaysTakenData(Buffer &dst) {
+	std::memset(dst.data, 1, dst.size);
+}
+
+static void writeRandomData(Buffer &dst, double takenProbability) {
+	auto bytes = reinterpret_cast<uint8_t*>(dst.data);
+	std::mt19937_64 rng(0xB7A4C8);
+	std::bernoulli_distribution dist(takenProbability);
+	for (size_t i = 0; i < dst.size; i++)
+		bytes[i] = dist(rng) ? 1 : 0;
+}
+
+// Random block of period bytes, repeated: only a predictor tracking at least period branches of history gets it right
+static void writePeriodicData(Buffer &dst, size_t period) {
+	auto bytes = reinterpret_cast<uint8_t*>(dst.data);
+	std::mt19937_64 rng(0xB7A4C8 + period);
+	std::bernoulli_distribution dist(0.5);
+	for (size_t i = 0; i < period && i < dst.size; i++)
+		bytes[i] = dist(rng) ? 1 : 0;
+	for (size_t i = period; i < dst.size; i++)
+		bytes[i] = bytes[i - period];
+}
+
+// Even branches are random, odd branches repeat the random outcome from distance pairs ago
+// Half of the branches are predictable given 2 * distance branches of global history
+static void writeCorrelatedData(Buffer &dst, size_t distance) {
+	auto bytes = reinterpret_cast<uint8_t*>(dst.data);
+	std::mt19937_64 rng(0xB7A4C8 + distance);
+	std::bernoulli_distribution dist(0.5);
+	for (size_t i = 0; i < dst.size; i += 2) {
+		bytes[i] = dist(rng) ? 1 : 0;
+		if (i + 1 < dst.size)
+			bytes[i + 1] = i >= distance * 2 ? bytes[i - distance * 2] : 0;
+	}
+}
+
+static void writeRandomSelectorData(Buffer &dst, size_t targetCount) {
+	auto bytes = reinterpret_cast<uint8_t*>(dst.data);
+	std::mt19937_64 rng(0x1D1EC7 + targetCount);
+	std::uniform_int_distribution<size_t> dist(0, targetCount - 1);
+	for (size_t i = 0; i < dst.size; i++)
+		bytes[i] = static_cast<uint8_t>(dist(rng));
+}
+
+static void writeCyclicSelectorData(Buffer &dst, size_t targetCount) {
+	auto bytes = reinterpret_cast<uint8_t*>(dst.data);
+	for (size_t i = 0; i < dst.size; i++)
+		bytes[i] = static_cast<uint8_t>(i % targetCount);
+}
+
+static Duration benchmarkBranchPattern(const DurationMeasurer &durationMeasurer, const Report &report, const Buffer &buffer, const std::string &opStr, bool indirect) {
+	auto res = indirect ? measureIndirect(durationMeasurer, buffer) : measureConditional(durationMeasurer, buffer);
+	const char *execution = indirect ? "Indirect" : "Conditional";
+	std::printf("%s, Op = %s %s: avg = %g cycles per branch (%g MHz)\n", report.meta, opStr.c_str(), execution, res.mean.lengthCycles, res.mean.inferredFrequencyMHz());
+	report.writeRow(opStr, execution, buffer.size, res);
+	return res.mean;
+}
+
+void benchmarkBranch(const DurationMeasurer &durationMeasurer, const Report &report) {
+	auto buffer = Buffer(branchCount);
+
+	writeAlwaysTakenData(buffer);
+	auto alwaysTaken = benchmarkBranchPattern(durationMeasurer, report, buffer, "Branch always taken", false);
+
+	Duration fullyRandom = alwaysTaken;
+	for (auto entropy : {0.05, 0.1, 0.25, 0.5, 0.75, 1.0}) {
+		auto p = takenProbabilityForEntropy(entropy);
+		writeRandomData(buffer, p);
+		std::stringstream ss;
+		ss << "Branch random entropy " << entropy << " bits (p = " << p << ")";
+		fullyRandom = benchmarkBranchPattern(durationMeasurer, report, buffer, ss.str(), false);
+	}
+
+	// A fair coin is mispredicted half of the time whatever the predictor
+	auto penalty = Duration{
+		.lengthCycles = std::max(fullyRandom.lengthCycles - alwaysTaken.lengthCycles, 0.0) / 0.5,
+		.lengthSeconds = std::max(fullyRandom.lengthSeconds - alwaysTaken.lengthSeconds, 0.0) / 0.5
+	};
+	std::printf("%s, Branch misprediction penalty: %g cycles\n", report.meta, penalty.lengthCycles);
+	report.writeRow("Branch misprediction penalty", "Derived", buffer.size, penalty);
+
+	size_t capturedPeriod = 0;
+	// Without a penalty, no period can be told apart from a captured one
+	auto derivable = penalty.lengthCycles > 0.0;
+	bool captured = true;
+	for (size_t period = 2; period <= branchCount / 2; period *= 2) {
+		writePeriodicData(buffer, period);
+		std::stringstream ss;
+		ss << "Branch periodic period " << period;
+		auto res = benchmarkBranchPattern(durationMeasurer, report, buffer, ss.str(), false);
+
+		// Half of a random period is mispredicted once it no longer fits
+		auto mispredictionRate = derivable ? (res.lengthCycles - alwaysTaken.lengthCycles) / penalty.lengthCycles : 1.0;
+		captured = captured && mispredictionRate < capturedMispredictionRate;
+		if (captured)
+			capturedPeriod = period;
+	}
+	if (derivable) {
+		std::printf("%s, Branch predictor history capacity: %zu branches\n", report.meta, capturedPeriod);
+		report.writeFigure("Branch predictor history capacity", "Derived", buffer.size, static_cast<double>(capturedPeriod), "branch");
+	} else
+		std::printf("%s, Branch predictor history capacity: not derivable, no misprediction penalty was measured\n", report.meta);
+
+	for (size_t distance = 1; distance <= 1 << 10; distance *= 2) {
+		writeCorrelatedData(buffer, distance);
+		std::stringstream ss;
+		ss << "Branch correlated distance " << distance;
+		benchmarkBranchPattern(durationMeasurer, report, buffer, ss.str(), false);
+	}
+
+	for (size_t targetCount = 1; targetCount <= indirectTargetCount; targetCount *= 2) {
+		writeCyclicSelectorData(buffer, targetCount);
+		std::stringstream cyclic;
+		cyclic << "Indirect jump cyclic " << targetCount << " targets";
+		benchmarkBranchPattern(durationMeasurer, report, buffer, cyclic.str(), true);
+
+		writeRandomSelectorData(buffer, targetCount);
+		std::stringstream random;
+		random << "Indirect jump random " << targetCount << " targets";
+		benchmarkBranchPattern(durationMeasurer, report, buffer, random.str(), true);
+	}
+
+	std::printf("\n");
+}
+
+}
\ No newline at end of file
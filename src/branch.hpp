@@ -0,0 +1,12 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+// Cycles per branch over generated outcome buffers (one byte per branch): always taken, periodic, random at a given entropy, correlated and indirect
+// The misprediction penalty and the predictor history capacity are derived from these and reported as extra rows
+void benchmarkBranch(const DurationMeasurer &durationMeasurer, const Report &report);
+
+}
\ No newline at end of file
@@ -0,0 +1,648 @@
+#include "clock.hpp"
+
+#ifdef _WIN32
+#include <Tchar.h>
+extern "C" {
+#include <WinRing0/OlsApi.h>
+}
+#endif
+
+#include <fstream>
+#include <mutex>
+#include <set>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <cpuid.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ipc {
+
+#ifdef _WIN32
+
+static_assert(sizeof(DWORD) == sizeof(uint32_t), "DWORD size must be 4");
+
+// Largely adapted from https://stackoverflow.com/a/17387176
+// Inefficient but who cares, everything is already going down if that gets called
+static std::string winGetLastError(void) {
+	//Get the error message ID, if any.
+	DWORD errorMessageID = ::GetLastError();
+	if (errorMessageID == 0) {
+		return std::string(); //No error message has been recorded
+	}
+
+	LPSTR messageBuffer = nullptr;
+
+	//Ask Win32 to give us the string version of that message ID.
+	//The parameters we pass in, tell Win32 to create the buffer that holds the message for us (because we don't yet know how long the message string will be).
+	size_t size = FormatMessageA(
+		FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+		NULL, errorMessageID, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&messageBuffer, 0, NULL
+	);
+
+	//Copy the error message into a std::string.
+	std::string message(messageBuffer, size);
+
+	//Free the Win32's string's buffer.
+	LocalFree(messageBuffer);
+	return message;
+}
+
+#endif
+
+std::string getCPUInfo(void)
+{
+	#ifdef _WIN32
+
+	// From https://stackoverflow.com/a/64422512
+
+        // 4 is essentially hardcoded due to the __cpuid function requirements.
+        // NOTE: Results are limited to whatever the sizeof(int) * 4 is...
+        std::array<int, 4> integerBuffer = {};
+        constexpr size_t sizeofIntegerBuffer = sizeof(int) * integerBuffer.size();
+
+        std::array<char, 64> charBuffer = {};
+
+        // The information you wanna query __cpuid for.
+        // https://learn.microsoft.com/en-us/cpp/intrinsics/cpuid-cpuidex?view=vs-2019
+        constexpr std::array<uint32_t, 3> functionIds = {
+		// Manufacturer
+		//  EX: "Intel(R) Core(TM"
+		0x8000'0002,
+		// Model
+		//  EX: ") i7-8700K CPU @"
+		0x8000'0003,
+		// Clockspeed
+		//  EX: " 3.70GHz"
+		0x8000'0004
+        };
+
+        std::string cpu;
+
+        for (int id : functionIds)
+        {
+		// Get the data for the current ID.
+		__cpuid(integerBuffer.data(), id);
+
+		// Copy the raw data from the integer buffer into the character buffer
+		std::memcpy(charBuffer.data(), integerBuffer.data(), sizeofIntegerBuffer);
+
+		// Copy that data into a std::string
+		cpu += std::string(charBuffer.data());
+        }
+
+        return cpu;
+
+	#else
+
+	std::ifstream input("/proc/cpuinfo", std::ios::in);
+	if (!input.good())
+		throw std::runtime_error("ipc::getCPUInfo: Could not open /proc/cpuinfo");
+
+	auto split = [](const std::string &str, char delim) {
+		std::stringstream tokenSs(str);
+		std::vector<std::string> tokens;
+		std::string token;
+		while (std::getline(tokenSs, token, delim))
+			tokens.emplace_back(token);
+		return tokens;
+	};
+
+	auto join = [](const std::vector<std::string> &strs) {
+		std::string res;
+		for (auto &str : strs)
+			res += str;
+		return res;
+	};
+
+	auto trim = [](const std::string &str) {
+		std::string res;
+		for (auto c : str) {
+			if (c == ' ' || c == '\n' || c == '\t' || c == '\r')
+				continue;
+			res.push_back(c);
+		}
+		return res;
+	};
+
+	std::string line;
+	while (std::getline(input, line)) {
+		auto sections = split(line, ':');
+		if (sections.size() < 2)
+			continue;
+
+		auto id = split(sections[0], ' ');
+		if (id.size() < 2)
+			continue;
+		if (trim(id[0]) == "model" && trim(id[1]) == "name") {
+			std::vector<std::string> modelName;
+			for (size_t i = 1; i < sections.size(); i++)
+				modelName.emplace_back(sections[i]);
+			modelName[0] = modelName[0].substr(1);
+			return join(modelName);
+		}
+	}
+
+	throw std::runtime_error("ipc::getCPUInfo: /proc/cpuinfo did not contain a single entry with 'model name'");
+
+	#endif
+}
+
+void setRealtime(void) {
+#ifdef _WIN32
+
+	auto res = SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS);
+	if (res == 0) {
+		std::stringstream ss;
+		ss << "ipc::setRealtime(_WIN32): SetPriorityClass: " << winGetLastError();
+		throw std::runtime_error(ss.str());
+	}
+
+	auto priority = GetPriorityClass(GetCurrentProcess());
+	if (priority == 0) {
+		std::stringstream ss;
+		ss << "ipc::setRealtime(_WIN32): GetPriorityClass: " << winGetLastError();
+		throw std::runtime_error(ss.str());
+	}
+	if (priority != REALTIME_PRIORITY_CLASS) {
+		std::stringstream ss;
+		ss << "ipc::setRealtime(_WIN32): " << "System call did succeed but priority is still lower than required (have 0x" << std::hex << priority << "). Try running the program with administrator priviledges to have the realtime mode go through.";
+		throw std::runtime_error(ss.str());
+	}
+
+	std::printf("ipc::setRealtime: Certified now running in realtime mode!\n");
+
+#else
+
+	std::printf("ipc::setRealtime: Disclaimer: it is advised not to run this in WSL unless WSL itself is running as realtime (which sounds like a crazy & horribly scary idea). Just pick up the Windows binary in this case.\n");
+
+	auto res = nice(-20);
+	if (res == -1) {
+		std::stringstream ss;
+		ss << "ipc::setRealtime(unistd.h): " << strerror(errno);
+		throw std::runtime_error(ss.str());
+	}
+
+	std::printf("ipc::setRealtime: Nice value for the process is now %d\n", res);
+
+#endif
+}
+
+void pinThreadToCore(size_t core) {
+#ifdef _WIN32
+
+	if (core >= 64 || SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core) == 0) {
+		std::stringstream ss;
+		ss << "ipc::pinThreadToCore(_WIN32): Could not pin to core " << core << ": " << winGetLastError();
+		throw std::runtime_error(ss.str());
+	}
+
+#else
+
+	if (core >= CPU_SETSIZE) {
+		std::stringstream ss;
+		ss << "ipc::pinThreadToCore(pthread.h): Core " << core << " is out of range";
+		throw std::runtime_error(ss.str());
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	auto res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (res != 0) {
+		std::stringstream ss;
+		ss << "ipc::pinThreadToCore(pthread.h): Could not pin to core " << core << ": " << strerror(res);
+		throw std::runtime_error(ss.str());
+	}
+
+#endif
+}
+
+std::map<size_t, size_t> getDataCacheSizes(void) {
+	std::map<size_t, size_t> res;
+
+	#ifdef _WIN32
+
+	DWORD length = 0;
+	GetLogicalProcessorInformation(nullptr, &length);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!GetLogicalProcessorInformation(infos.data(), &length)) {
+		std::stringstream ss;
+		ss << "ipc::getDataCacheSizes(_WIN32): GetLogicalProcessorInformation: " << winGetLastError();
+		throw std::runtime_error(ss.str());
+	}
+	for (auto &info : infos) {
+		if (info.Relationship != RelationCache)
+			continue;
+		if (info.Cache.Type != CacheData && info.Cache.Type != CacheUnified)
+			continue;
+		res.emplace(info.Cache.Level, info.Cache.Size);
+	}
+
+	#else
+
+	auto readLine = [](const std::filesystem::path &path) {
+		std::ifstream input(path, std::ios::in);
+		std::string line;
+		std::getline(input, line);
+		return line;
+	};
+
+	for (size_t index = 0;; index++) {
+		auto dir = std::filesystem::path("/sys/devices/system/cpu/cpu0/cache") / ("index" + std::to_string(index));
+		if (!std::filesystem::exists(dir))
+			break;
+		auto type = readLine(dir / "type");
+		if (type != "Data" && type != "Unified")
+			continue;
+		auto sizeStr = readLine(dir / "size");
+		if (sizeStr.empty())
+			continue;
+		size_t size = std::stoull(sizeStr);
+		if (sizeStr.back() == 'K')
+			size <<= 10;
+		else if (sizeStr.back() == 'M')
+			size <<= 20;
+		res.emplace(std::stoull(readLine(dir / "level")), size);
+	}
+
+	#endif
+
+	if (res.empty())
+		throw std::runtime_error("ipc::getDataCacheSizes: No data cache found");
+	return res;
+}
+
+size_t getResidentSetSize(void) {
+#ifdef _WIN32
+
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		std::stringstream ss;
+		ss << "ipc::getResidentSetSize(_WIN32): K32GetProcessMemoryInfo: " << winGetLastError();
+		throw std::runtime_error(ss.str());
+	}
+	return counters.WorkingSetSize;
+
+#else
+
+	// Second field: resident pages
+	std::ifstream input("/proc/self/statm", std::ios::in);
+	size_t totalPages = 0, residentPages = 0;
+	if (!(input >> totalPages >> residentPages))
+		throw std::runtime_error("ipc::getResidentSetSize(unistd.h): Could not read /proc/self/statm");
+	return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+#endif
+}
+
+bool areTransparentHugePagesEnabled(void) {
+#ifdef _WIN32
+	return false;
+#else
+	// Missing without THP support, "[always]", "[madvise]" or "[never]" is the policy
+	std::ifstream input("/sys/kernel/mm/transparent_hugepage/enabled", std::ios::in);
+	std::string line;
+	std::getline(input, line);
+	return !line.empty() && line.find("[never]") == std::string::npos;
+#endif
+}
+
+#ifndef _WIN32
+
+// /dev/cpu/<core>/msr of the msr kernel module, opened once per logical processor and kept open
+static int getMSRFile(size_t core) {
+	static std::mutex mutex;
+	static std::vector<int> files;
+
+	std::lock_guard lock(mutex);
+	if (core >= files.size())
+		files.resize(core + 1, -1);
+	if (files[core] < 0) {
+		auto path = "/dev/cpu/" + std::to_string(core) + "/msr";
+		files[core] = open(path.c_str(), O_RDWR | O_CLOEXEC);
+		if (files[core] < 0)
+			throw std::runtime_error("ipc::getMSRFile(unistd.h): Could not open '" + path + "': " + strerror(errno) + ". Is the msr module loaded (modprobe msr) and are we root?");
+	}
+	return files[core];
+}
+
+static bool readMSRFile(uint32_t index, size_t core, uint64_t &value) {
+	return pread(getMSRFile(core), &value, sizeof(value), index) == sizeof(value);
+}
+
+static bool writeMSRFile(uint32_t index, size_t core, uint64_t value) {
+	return pwrite(getMSRFile(core), &value, sizeof(value), index) == sizeof(value);
+}
+
+#endif
+
+void cpuID(uint32_t index, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+#ifdef _WIN32
+	DWORD beax, bebx, becx, bedx;
+	if (!Cpuid(index, &beax, &bebx, &becx, &bedx)) {
+		std::stringstream ss;
+		ss << "ipc::cpuID: Could not read index 0x" << std::hex << index;
+		throw std::runtime_error(ss.str());
+	}
+#else
+	uint32_t beax, bebx, becx, bedx;
+	__cpuid_count(index, 0, beax, bebx, becx, bedx);
+#endif
+	if (eax != nullptr)
+		*eax = beax;
+	if (ebx != nullptr)
+		*ebx = bebx;
+	if (ecx != nullptr)
+		*ecx = becx;
+	if (edx != nullptr)
+		*edx = bedx;
+}
+
+uint64_t readMSR(uint32_t index) {
+#ifdef _WIN32
+	DWORD low, high;
+	if (!Rdmsr(index, &low, &high)) {
+		std::stringstream ss;
+		ss << "ipc::readMSR: Could not read index 0x" << std::hex << index;
+		throw std::runtime_error(ss.str());
+	}
+	return (static_cast<uint64_t>(high) << 32) | static_cast<uint64_t>(low);
+#else
+	// Whichever logical processor we are on, like Rdmsr
+	auto core = sched_getcpu();
+	uint64_t res;
+	if (core < 0 || !readMSRFile(index, static_cast<size_t>(core), res)) {
+		std::stringstream ss;
+		ss << "ipc::readMSR: Could not read index 0x" << std::hex << index << ": " << strerror(errno);
+		throw std::runtime_error(ss.str());
+	}
+	return res;
+#endif
+}
+
+std::vector<size_t> getMSRCores(void) {
+	std::vector<size_t> res;
+#ifdef _WIN32
+	DWORD_PTR processMask, systemMask;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+		std::stringstream ss;
+		ss << "ipc::getMSRCores(_WIN32): GetProcessAffinityMask: " << winGetLastError();
+		throw std::runtime_error(ss.str());
+	}
+	for (size_t core = 0; core < 64; core++) {
+		if ((processMask >> core) & 1)
+			res.emplace_back(core);
+	}
+#else
+	cpu_set_t set;
+	if (sched_getaffinity(0, sizeof(set), &set) != 0)
+		throw std::runtime_error(std::string("ipc::getMSRCores(sched.h): sched_getaffinity: ") + strerror(errno));
+	for (size_t core = 0; core < CPU_SETSIZE; core++) {
+		if (CPU_ISSET(core, &set))
+			res.emplace_back(core);
+	}
+#endif
+	return res;
+}
+
+uint64_t readMSROnCore(uint32_t index, size_t core) {
+#ifdef _WIN32
+	DWORD low, high;
+	if (!RdmsrTx(index, &low, &high, static_cast<DWORD_PTR>(1) << core)) {
+		std::stringstream ss;
+		ss << "ipc::readMSROnCore: Could not read index 0x" << std::hex << index << " on core " << std::dec << core;
+		throw std::runtime_error(ss.str());
+	}
+	return (static_cast<uint64_t>(high) << 32) | static_cast<uint64_t>(low);
+#else
+	uint64_t res;
+	if (!readMSRFile(index, core, res)) {
+		std::stringstream ss;
+		ss << "ipc::readMSROnCore: Could not read index 0x" << std::hex << index << " on core " << std::dec << core << ": " << strerror(errno);
+		throw std::runtime_error(ss.str());
+	}
+	return res;
+#endif
+}
+
+void writeMSROnCore(uint32_t index, size_t core, uint64_t value) {
+#ifdef _WIN32
+	auto low = static_cast<DWORD>(value & 0xFFFFFFFF);
+	auto high = static_cast<DWORD>(value >> 32);
+	if (!WrmsrTx(index, low, high, static_cast<DWORD_PTR>(1) << core)) {
+		std::stringstream ss;
+		ss << "ipc::writeMSROnCore: Could not write index 0x" << std::hex << index << " on core " << std::dec << core;
+		throw std::runtime_error(ss.str());
+	}
+#else
+	if (!writeMSRFile(index, core, value)) {
+		std::stringstream ss;
+		ss << "ipc::writeMSROnCore: Could not write index 0x" << std::hex << index << " on core " << std::dec << core << ": " << strerror(errno);
+		throw std::runtime_error(ss.str());
+	}
+#endif
+}
+
+CPUSignature getCPUSignature(void) {
+	CPUSignature res;
+
+	uint32_t lastCPUIDIndex = 0, vendorReg[3];
+	cpuID(0, &lastCPUIDIndex, &vendorReg[0], &vendorReg[2], &vendorReg[1]);
+	if (lastCPUIDIndex == 0)
+		throw std::runtime_error("ipc::getCPUSignature: CPUID index 0 failed: lastCPUIDIndex is zero");
+
+	auto appendRegToString = [](uint32_t reg, std::string &dst) {
+		for (size_t i = 0; i < 4; i++)
+			dst.push_back((reg >> (i * 8)) & 0xFF);
+	};
+	for (size_t i = 0; i < 3; i++)
+		appendRegToString(vendorReg[i], res.vendor);
+
+	uint32_t familyCode;
+	cpuID(1, &familyCode, nullptr, nullptr, nullptr);
+	res.family = ((familyCode & 0x0FF00000) >> 20) + ((familyCode & 0x0F00) >> 8);
+	res.model = ((familyCode & 0x0F0000) >> 12) + ((familyCode & 0xF0) >> 4);
+
+	return res;
+}
+
+// This funcion is largely ported from https://github.com/openhardwaremonitor/openhardwaremonitor
+std::function<double (void)> DurationMeasurer::getFrequencyGetter(void) {
+#ifdef _WIN32
+	{
+		if (!InitializeOls())
+			throw std::runtime_error("ipc::DurationMeasurer::InitOpenLibSys: Failure. Is the WinRing0 service installed & running? Alternatively, you can have OpenHardwareMonitor running to make this service available too.");
+	}
+	if (!IsMsr())
+		throw std::runtime_error("ipc::DurationMeasurer::IsMsr: Failure. Cannot read MSRs.");
+	std::printf("WinRing0: Initialized!\n");
+#else
+	// Fails early with the reason, rather than on the first frequency reading
+	getMSRFile(0);
+	std::printf("msr: Initialized!\n");
+#endif
+
+	auto signature = getCPUSignature();
+	const auto &vendor = signature.vendor;
+	auto family = signature.family;
+	auto model = signature.model;
+	std::printf("Vendor: %s, family = 0x%zx, model = 0x%zx\n", vendor.c_str(), family, model);
+
+	auto getTscFreq = []() {
+		std::printf("Estimating TSC frequency..\n");
+		auto bef = std::chrono::high_resolution_clock::now();
+		auto tscBef = __rdtsc();
+		std::this_thread::sleep_for(std::chrono::seconds(4));
+		auto aft = std::chrono::high_resolution_clock::now();
+		auto tscAft = __rdtsc();
+
+		auto res = static_cast<double>(tscAft - tscBef) / static_cast<std::chrono::duration<double>>(aft - bef).count();
+		std::printf("TSC at %g MHz\n", res / 1.0e6);
+
+		return res;
+	};
+
+	if (vendor == "GenuineIntel") {
+		// Reference: Hardware/CPU/IntelCPU.cs
+		static std::set<size_t> commonModels = {
+			0x2A, 0x2D,	// SandyBridge
+			0x3A, 0x3E,	// IvyBridge
+			0x3C, 0x3F, 0x45, 0x46,	// Haswell
+			0x3D, 0x47, 0x4F, 0x56,	// Boardwell
+			0x37, 0x4A, 0x4D, 0x5A, 0x5D,	// Silvermont
+			0x4E, 0x5E, 0x55,	// Skylake
+			0x8E, 0x9E,	// KabyLake
+			0x5C, 0x5F, 	// Goldmont
+			0x7A,	// GoldmontPlus
+			0x66,	// CannonLake
+			0x7D, 0x7E, 0x6A, 0x6C,	// IceLake
+			0xA5, 0xA6,	// CometLake
+			0x86, 	// Tremont
+			0x8C, 0x8D,	// TigerLake
+		};
+		static std::set<size_t> nehalemModels = {
+			0x1A, 0x1E, 0x1F, 0x25, 0x2C, 0x2E, 0x2F
+		};
+		bool isNehalem = nehalemModels.contains(model);
+		bool isCommonModel = commonModels.contains(model);
+
+		auto getTscInvFactor = []() {
+			auto a = readMSR(0xCE);
+			return static_cast<double>((a >> 8) & 0xff);
+		};
+
+		double busClock = getTscFreq() / getTscInvFactor();
+		if (isNehalem) {
+			return [busClock]() {
+				auto a = readMSR(0x0198);
+				auto multiplier = static_cast<double>(a & 0xff);
+				return busClock * multiplier;
+			};
+		} else if (isCommonModel) {
+			return [busClock]() {
+				auto a = readMSR(0x0198);
+				auto multiplier = static_cast<double>((a >> 8) & 0xff);
+				return busClock * multiplier;
+			};
+		} else {
+			return [busClock]() {
+				auto a = readMSR(0x0198);
+				auto multiplier = static_cast<double>((a >> 8) & 0x1f) + 0.5 * static_cast<double>((a >> 14) & 1);
+				return busClock * multiplier;
+			};
+		}
+	} else if (vendor == "AuthenticAMD") {
+		if (family == 0x0F) {
+			// Reference: Hardware/CPU/AMD0FCPU.cs
+			auto tscFreq = getTscFreq();
+			return [tscFreq]() {
+				auto a = readMSR(0xC0010042);
+				double curMP = 0.5 * static_cast<double>((a & 0x3F) + 8);
+				double maxMP = 0.5 * static_cast<double>((a >> 16 & 0x3F) + 8);
+				return curMP * tscFreq / maxMP;
+			};
+		} else if (family == 0x10 || family == 0x11 || family == 0x12 || family == 0x14 || family == 0x15 || family == 0x16) {
+			// Reference: Hardware/CPU/AMD10CPU.cs
+			throw std::runtime_error("ipc::DurationMeasurer:getFrequencyGetter: Unsupported AMD10 CPU D:");
+		} else if (family == 0x17 || family == 0x19) {
+			// Reference: Hardware/CPU/AMD17CPU.cs
+			auto getTscInvFactor = []() {
+				auto a = readMSR(0xC0010064);
+				auto cpuDfsId = (a >> 8) & 0x3f;
+				auto cpuFid = a & 0xff;
+				return 2.0 * static_cast<double>(cpuFid) / static_cast<double>(cpuDfsId);
+			};
+
+			double busClock = getTscFreq() / getTscInvFactor();
+			return [busClock]() {
+				auto a = readMSR(0xc0010293);
+				auto cpuDfsId = (a >> 8) & 0x3f;
+				auto cpuFid = a & 0xff;
+				auto multiplier = 2.0 * static_cast<double>(cpuFid) / static_cast<double>(cpuDfsId);
+				return busClock * multiplier;
+			};
+		} else {
+			std::stringstream ss;
+			ss << "ipc::DurationMeasurer:getFrequencyGetter: Unknown family 0x" << std::hex << family << " for vendor '" << vendor << "'";
+			throw std::runtime_error(ss.str());
+		}
+	} else {
+		std::stringstream ss;
+		ss << "ipc::DurationMeasurer:getFrequencyGetter: Unknown vendor '" << vendor << "'";
+		throw std::runtime_error(ss.str());
+	}
+}
+
+DurationMeasurer::DurationMeasurer(void) :
+	m_getFrequency(getFrequencyGetter()),
+	m_overhead({
+		.lengthCycles = 0.0,
+		.lengthSeconds = 0.0
+	})
+{
+	/*for (size_t i = 0; i < 16; i++) {
+		std::printf("Current frequency: %g MHz\n", m_getFrequency() / 1.0e6);
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}*/
+}
+
+DurationMeasurer::~DurationMeasurer(void) {
+#ifdef _WIN32
+	DeinitializeOls();
+#endif
+}
+
+Duration DurationMeasurer::computeCalibration(void) const {
+
+	std::printf("ipc::DurationMeasurer::computeCalibration: Calibrating, this should take around %g seconds..\n", calibrationLengthSeconds);
+
+	constexpr double lengthPerIteration = calibrationLengthSeconds / static_cast<double>(calibrationIterationCount);
+
+
+	Duration durations[calibrationIterationCount];
+
+	for (size_t i = 0; i < calibrationIterationCount; i++) {
+		std::this_thread::sleep_for(std::chrono::duration<double>(lengthPerIteration));
+		// Warmup
+		for (size_t i = 0; i < 64; i++) {
+			durations[i] = measure([](){}, false);
+		}
+		// Actual data
+		durations[i] = measure([](){}, false);
+	}
+
+	std::printf("ipc::DurationMeasurer::computeCalibration: Calibration done.\n");
+
+	return Duration::average(durations);
+}
+
+void DurationMeasurer::calibrate(void) {
+	m_overhead = computeCalibration();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "compare.hpp"
+#include "report.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+namespace ipc {
+
+// CPU model, operation, execution, buffer size
+using CompareKey = std::tuple<std::string, std::string, std::string, size_t>;
+
+struct CompareRow {
+	// Cycle count of the report row, averaged if the row is repeated
+	double cycles = 0.0;
+	size_t rowCount = 0;
+	// Per-operation cycle counts from the trace, empty without one
+	std::vector<double> samples;
+};
+
+struct CompareResult {
+	CompareKey key;
+	double baseline;
+	double candidate;
+	// In percent, positive is slower
+	double change;
+	// NaN when untested
+	double pValue;
+	bool significant;
+};
+
+static std::vector<std::string> splitCsvLine(const std::string &line) {
+	std::vector<std::string> res;
+	std::stringstream ss(line);
+	std::string field;
+	while (std::getline(ss, field, ',')) {
+		auto first = field.find_first_not_of(" \t\r");
+		auto last = field.find_last_not_of(" \t\r");
+		res.emplace_back(first == std::string::npos ? std::string() : field.substr(first, last - first + 1));
+	}
+	return res;
+}
+
+// header: expected first line, cycleColumn: index of the cycle count among its fields
+static void readCsv(const std::string &path, const char *header, size_t cycleColumn, const std::function<void (const CompareKey &key, double cycles)> &onRow) {
+	std::ifstream input(path, std::ios::in);
+	if (!input.good())
+		throw std::runtime_error("ipc::compareReports: Could not open '" + path + "' for reading");
+
+	std::string line;
+	if (!std::getline(input, line) || splitCsvLine(line) != splitCsvLine(header))
+		throw std::runtime_error("ipc::compareReports: '" + path + "' does not start with the expected header '" + header + "'");
+
+	size_t lineIndex = 1;
+	while (std::getline(input, line)) {
+		lineIndex++;
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		auto fields = splitCsvLine(line);
+		if (fields.size() <= cycleColumn) {
+			std::stringstream ss;
+			ss << "ipc::compareReports: '" << path << "', line " << lineIndex << ": Expected at least " << cycleColumn + 1 << " fields, got " << fields.size();
+			throw std::runtime_error(ss.str());
+		}
+		try {
+			onRow(CompareKey(fields[1], fields[2], fields[3], std::stoull(fields[4])), std::stod(fields[cycleColumn]));
+		} catch (const std::logic_error&) {
+			std::stringstream ss;
+			ss << "ipc::compareReports: '" << path << "', line " << lineIndex << ": Malformed buffer size or cycle count";
+			throw std::runtime_error(ss.str());
+		}
+	}
+}
+
+// Figures (bytes, branches..) are not cycles: neither their direction nor their spread means anything here
+static std::map<CompareKey, CompareRow> loadReport(const std::string &path) {
+	std::map<CompareKey, CompareRow> res;
+	readCsv(path, Report::header, 5, [&](const CompareKey &key, double cycles) {
+		if (Report::isFigure(std::get<2>(key)))
+			return;
+		auto &row = res[key];
+		row.rowCount++;
+		row.cycles += (cycles - row.cycles) / static_cast<double>(row.rowCount);
+	});
+
+	auto tracePath = Report::tracePath(path);
+	// Traces are optional
+	if (std::ifstream(tracePath, std::ios::in).good()) {
+		readCsv(tracePath, Report::traceHeader, 6, [&](const CompareKey &key, double cycles) {
+			auto found = res.find(key);
+			if (found != res.end())
+				found->second.samples.emplace_back(cycles);
+		});
+	}
+	return res;
+}
+
+// Continued fraction of the regularized incomplete beta function, converges for x < (a + 1) / (a + b + 2)
+static double incompleteBetaFraction(double a, double b, double x) {
+	constexpr double tiny = 1.0e-300;
+	constexpr double epsilon = 1.0e-15;
+
+	double c = 1.0;
+	double d = 1.0 - (a + b) * x / (a + 1.0);
+	d = 1.0 / (std::abs(d) < tiny ? tiny : d);
+	double res = d;
+	for (size_t m = 1; m <= 1000; m++) {
+		auto md = static_cast<double>(m);
+		for (auto numerator : {
+			md * (b - md) * x / ((a + 2.0 * md - 1.0) * (a + 2.0 * md)),
+			-(a + md) * (a + b + md) * x / ((a + 2.0 * md) * (a + 2.0 * md + 1.0))
+		}) {
+			d = 1.0 + numerator * d;
+			d = 1.0 / (std::abs(d) < tiny ? tiny : d);
+			c = 1.0 + numerator / c;
+			c = std::abs(c) < tiny ? tiny : c;
+			res *= c * d;
+		}
+		if (std::abs(c * d - 1.0) < epsilon)
+			break;
+	}
+	return res;
+}
+
+static double regularizedIncompleteBeta(double a, double b, double x) {
+	if (x <= 0.0)
+		return 0.0;
+	if (x >= 1.0)
+		return 1.0;
+	auto front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log1p(-x));
+	if (x < (a + 1.0) / (a + b + 2.0))
+		return front * incompleteBetaFraction(a, b, x) / a;
+	return 1.0 - front * incompleteBetaFraction(b, a, 1.0 - x) / b;
+}
+
+// Two-sided p-value of Welch's t-test: do both sample sets share the same mean
+static double welchTTest(const std::vector<double> &a, const std::vector<double> &b) {
+	auto meanVariance = [](const std::vector<double> &samples) {
+		double mean = 0.0;
+		for (auto sample : samples)
+			mean += sample;
+		mean /= static_cast<double>(samples.size());
+		double variance = 0.0;
+		for (auto sample : samples)
+			variance += (sample - mean) * (sample - mean);
+		return std::make_pair(mean, variance / static_cast<double>(samples.size() - 1));
+	};
+
+	auto [meanA, varianceA] = meanVariance(a);
+	auto [meanB, varianceB] = meanVariance(b);
+	auto errorA = varianceA / static_cast<double>(a.size());
+	auto errorB = varianceB / static_cast<double>(b.size());
+	auto error = errorA + errorB;
+	if (error <= 0.0)
+		return meanA == meanB ? 1.0 : 0.0;
+
+	auto t = (meanB - meanA) / std::sqrt(error);
+	auto degreesOfFreedom = error * error / (errorA * errorA / static_cast<double>(a.size() - 1) + errorB * errorB / static_cast<double>(b.size() - 1));
+	return regularizedIncompleteBeta(degreesOfFreedom / 2.0, 0.5, degreesOfFreedom / (degreesOfFreedom + t * t));
+}
+
+static std::vector<CompareResult> compareReport(const CompareOptions &options, const std::map<CompareKey, CompareRow> &baseline, const std::map<CompareKey, CompareRow> &candidate,
+	size_t &baselineOnlyCount, size_t &candidateOnlyCount) {
+	std::vector<CompareResult> res;
+	baselineOnlyCount = 0;
+	candidateOnlyCount = 0;
+
+	for (auto &[key, baselineRow] : baseline) {
+		auto found = candidate.find(key);
+		if (found == candidate.end()) {
+			baselineOnlyCount++;
+			continue;
+		}
+		auto &candidateRow = found->second;
+
+		// Rows of zero cycles (e.g. a derived penalty clamped to 0) have no relative change
+		auto change = baselineRow.cycles != 0.0 ? (candidateRow.cycles - baselineRow.cycles) / std::abs(baselineRow.cycles) * 100.0 : 0.0;
+		auto tested = baselineRow.samples.size() >= 2 && candidateRow.samples.size() >= 2;
+		auto pValue = tested ? welchTTest(baselineRow.samples, candidateRow.samples) : std::numeric_limits<double>::quiet_NaN();
+		res.emplace_back(CompareResult{
+			.key = key,
+			.baseline = baselineRow.cycles,
+			.candidate = candidateRow.cycles,
+			.change = change,
+			.pValue = pValue,
+			// An unchanged row is never significant, even under a threshold of 0
+			.significant = change != 0.0 && std::abs(change) >= options.thresholdPercent && (!tested || pValue < options.alpha)
+		});
+	}
+	for (auto &[key, candidateRow] : candidate) {
+		if (!baseline.contains(key))
+			candidateOnlyCount++;
+	}
+	return res;
+}
+
+static void printResults(const char *title, std::vector<CompareResult> results) {
+	std::printf("%s: %zu\n", title, results.size());
+	// Largest relative change first
+	std::sort(results.begin(), results.end(), [](const CompareResult &a, const CompareResult &b) {
+		return std::abs(a.change) > std::abs(b.change);
+	});
+	for (auto &result : results) {
+		auto &[cpuInfo, op, execution, bufferSize] = result.key;
+		std::printf("  Op = %s %s, buffer size = %zu bytes: %g -> %g cycles (%+.2f%%, ", op.c_str(), execution.c_str(), bufferSize, result.baseline, result.candidate, result.change);
+		if (std::isnan(result.pValue))
+			std::printf("untested)");
+		else
+			std::printf("p = %.3g)", result.pValue);
+		std::printf(" [%s]\n", cpuInfo.c_str());
+	}
+}
+
+int compareReports(const CompareOptions &options) {
+	if (options.candidatePaths.empty())
+		throw std::runtime_error("ipc::compareReports: At least one candidate report is required");
+	if (options.thresholdPercent < 0.0 || !(options.alpha > 0.0 && options.alpha < 1.0)) {
+		std::stringstream ss;
+		ss << "ipc::compareReports: Threshold must be positive and alpha in ]0, 1[, got " << options.thresholdPercent << "% and " << options.alpha;
+		throw std::runtime_error(ss.str());
+	}
+
+	std::ofstream output;
+	if (!options.outputPath.empty()) {
+		output.open(options.outputPath, std::ios::out);
+		if (!output.good())
+			throw std::runtime_error("ipc::compareReports: Could not open '" + options.outputPath + "' for writing");
+		output << "Candidate, CPU model, Operation, Execution, Buffer size [byte], Baseline [cycle], Candidate [cycle], Change [%], p-value, Verdict" << std::endl;
+	}
+
+	auto baseline = loadReport(options.baselinePath);
+	size_t regressionCount = 0;
+	for (auto &candidatePath : options.candidatePaths) {
+		auto candidate = loadReport(candidatePath);
+		size_t baselineOnlyCount, candidateOnlyCount;
+		auto results = compareReport(options, baseline, candidate, baselineOnlyCount, candidateOnlyCount);
+
+		std::vector<CompareResult> regressions, improvements;
+		for (auto &result : results) {
+			if (!result.significant)
+				continue;
+			(result.change > 0.0 ? regressions : improvements).emplace_back(result);
+		}
+
+		std::printf("Baseline = %s, Candidate = %s: %zu rows matched, %zu only in baseline, %zu only in candidate (threshold = %g%%, alpha = %g)\n",
+			options.baselinePath.c_str(), candidatePath.c_str(), results.size(), baselineOnlyCount, candidateOnlyCount, options.thresholdPercent, options.alpha);
+		printResults("Regressions", regressions);
+		printResults("Improvements", improvements);
+		std::printf("\n");
+		regressionCount += regressions.size();
+
+		if (output.is_open()) {
+			for (auto &result : results) {
+				auto &[cpuInfo, op, execution, bufferSize] = result.key;
+				output << candidatePath << ", " << cpuInfo << ", " << op << ", " << execution << ", " << bufferSize << ", " << result.baseline << ", " << result.candidate << ", " << result.change << ", ";
+				if (!std::isnan(result.pValue))
+					output << result.pValue;
+				output << ", " << (result.significant ? (result.change > 0.0 ? "Regression" : "Improvement") : "Unchanged") << std::endl;
+			}
+		}
+	}
+
+	return regressionCount > 0 ? 1 : 0;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ipc {
+
+struct CompareOptions {
+	// Relative change of a row's cycle count, in percent, under which it is considered unchanged
+	double thresholdPercent = 5.0;
+	// Significance level of the per-row test, only when both reports come with a trace
+	double alpha = 0.01;
+	// Optional, every matched row with its verdict
+	std::string outputPath;
+	std::string baselinePath;
+	std::vector<std::string> candidatePaths;
+};
+
+// Matches rows of each candidate report against the baseline by CPU model, operation, execution and buffer size (meta is ignored), figures are skipped
+// Rows are tested with Welch's t-test over the samples of <report>.trace.csv when both sides have one, on the threshold alone otherwise
+// More cycles is a regression. Returns the exit code: 0 without any significant regression, 1 otherwise
+int compareReports(const CompareOptions &options);
+
+}
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "dispatch.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace ipc {
+
+static inline constexpr size_t dispatchCallCount = 1 << 14;
+static inline constexpr size_t dispatchIterationCount = 1 << 8;
+static inline constexpr size_t dispatchMaxTargetCount = 64;
+// Results of independent calls are spread over this many words
+static inline constexpr size_t dispatchBufferSize = 1 << 12;
+
+static volatile size_t dispatchSink;
+
+static inline size_t dispatchOp(size_t x, size_t y) {
+	return x * 3 + y;
+}
+
+[[gnu::noinline]] static size_t dispatchDirect(size_t x, size_t y) {
+	return dispatchOp(x, y);
+}
+
+struct DispatchTarget {
+	virtual ~DispatchTarget(void) = default;
+	virtual size_t call(size_t x, size_t y) const = 0;
+};
+
+template <size_t I>
+struct DispatchTargetImpl : public DispatchTarget {
+	[[gnu::noinline]] size_t call(size_t x, size_t y) const override {
+		return dispatchOp(x, y) + I;
+	}
+};
+
+template <size_t... Is>
+static std::vector<std::unique_ptr<DispatchTarget>> makeDispatchTargets(std::index_sequence<Is...>) {
+	std::vector<std::unique_ptr<DispatchTarget>> res;
+	(res.emplace_back(std::make_unique<DispatchTargetImpl<Is>>()), ...);
+	return res;
+}
+
+// A call makes depth nested calls in total, itself included, then as many returns: depth is at least 1
+[[gnu::noinline]] static size_t dispatchChain(size_t depth, size_t x) {
+	if (depth <= 1)
+		return x;
+	auto res = dispatchChain(depth - 1, x);
+	// Keeps the recursion from being turned into a loop
+	asm volatile("" : "+r"(res));
+	return res + depth;
+}
+
+// Call is `size_t (size_t x, size_t i)`
+template <typename Call>
+static Statistics measureDispatchPipelined(const DurationMeasurer &durationMeasurer, Buffer &buffer, Call &&call) {
+	constexpr size_t wordCount = dispatchBufferSize / sizeof(size_t);
+	volatile auto words = reinterpret_cast<size_t * const>(buffer.data);
+
+	auto sample = [&]() {
+		return durationMeasurer.measure([&]() {
+			for (size_t i = 0; i < dispatchCallCount; i++)
+				words[i % wordCount] = call(i, i);
+		});
+	};
+
+	return sampleDurations(dispatchIterationCount, sample) / dispatchCallCount;
+}
+
+// Call is `size_t (size_t x, size_t i)`
+template <typename Call>
+static Statistics measureDispatchSequentially(const DurationMeasurer &durationMeasurer, Call &&call) {
+	auto sample = [&]() {
+		return durationMeasurer.measure([&]() {
+			size_t acc = 0;
+			for (size_t i = 0; i < dispatchCallCount; i++)
+				acc = call(acc, i);
+			dispatchSink = acc;
+		});
+	};
+
+	return sampleDurations(dispatchIterationCount, sample) / dispatchCallCount;
+}
+
+template <typename Call>
+static void benchmarkDispatchCall(const DurationMeasurer &durationMeasurer, const Report &report, Buffer &buffer, Call &&call, const std::string &opStr) {
+	{
+		auto pipelined = measureDispatchPipelined(durationMeasurer, buffer, call);
+		std::printf("%s, Op = %s pipelined: avg = %g cycles per call (%g MHz)\n", report.meta, opStr.c_str(), pipelined.mean.lengthCycles, pipelined.mean.inferredFrequencyMHz());
+		report.writeRow(opStr, "Pipelined", dispatchBufferSize, pipelined);
+	}
+
+	{
+		auto sequentially = measureDispatchSequentially(durationMeasurer, call);
+		std::printf("%s, Op = %s sequentially: avg = %g cycles per call (%g MHz)\n", report.meta, opStr.c_str(), sequentially.mean.lengthCycles, sequentially.mean.inferredFrequencyMHz());
+		report.writeRow(opStr, "Sequentially", dispatchBufferSize, sequentially);
+	}
+}
+
+static Statistics measureDispatchChain(const DurationMeasurer &durationMeasurer, size_t depth) {
+	auto chainCount = std::max<size_t>(dispatchCallCount / depth, 1);
+
+	auto sample = [&]() {
+		return durationMeasurer.measure([&]() {
+			size_t acc = 0;
+			for (size_t i = 0; i < chainCount; i++)
+				acc = dispatchChain(depth, acc);
+			dispatchSink = acc;
+		});
+	};
+
+	// One call and one return per level, the outermost one included
+	return sampleDurations(dispatchIterationCount, sample) / (chainCount * depth);
+}
+
+void benchmarkDispatch(const DurationMeasurer &durationMeasurer, const Report &report) {
+	auto buffer = Buffer(dispatchBufferSize);
+
+	benchmarkDispatchCall(durationMeasurer, report, buffer, [](size_t x, size_t i) {
+		return dispatchOp(x, i);
+	}, "Inlined lambda");
+
+	benchmarkDispatchCall(durationMeasurer, report, buffer, [](size_t x, size_t i) {
+		return dispatchDirect(x, i);
+	}, "Direct call");
+
+	{
+		auto fn = &dispatchDirect;
+		// Hide the target from the optimizer, so that the call is not turned back into a direct one
+		asm volatile("" : "+r"(fn));
+		benchmarkDispatchCall(durationMeasurer, report, buffer, [fn](size_t x, size_t i) {
+			return fn(x, i);
+		}, "Function pointer");
+	}
+
+	{
+		std::function<size_t (size_t, size_t)> fn = [](size_t x, size_t y) {
+			return dispatchOp(x, y);
+		};
+		benchmarkDispatchCall(durationMeasurer, report, buffer, [&fn](size_t x, size_t i) {
+			return fn(x, i);
+		}, "std::function");
+	}
+
+	{
+		auto targets = makeDispatchTargets(std::make_index_sequence<dispatchMaxTargetCount>());
+		std::vector<const DispatchTarget*> selected(dispatchCallCount);
+		std::mt19937_64 rng(0xD15C);
+		for (size_t targetCount = 1; targetCount <= dispatchMaxTargetCount; targetCount *= 2) {
+			std::uniform_int_distribution<size_t> dist(0, targetCount - 1);
+			for (auto &target : selected)
+				target = targets[dist(rng)].get();
+
+			std::stringstream ss;
+			ss << "Virtual call " << (targetCount == 1 ? "monomorphic" : "polymorphic") << " " << targetCount << " targets";
+			benchmarkDispatchCall(durationMeasurer, report, buffer, [&selected](size_t x, size_t i) {
+				return selected[i]->call(x, i);
+			}, ss.str());
+		}
+	}
+
+	for (auto depth : {1, 2, 4, 8, 12, 16, 20, 24, 32, 48, 64, 128, 256}) {
+		auto res = measureDispatchChain(durationMeasurer, depth);
+		std::stringstream ss;
+		ss << "Call chain depth " << depth;
+		std::printf("%s, Op = %s: avg = %g cycles per call and return (%g MHz)\n", report.meta, ss.str().c_str(), res.mean.lengthCycles, res.mean.inferredFrequencyMHz());
+		report.writeRow(ss.str(), "Call chain", dispatchBufferSize, res);
+	}
+
+	std::printf("\n");
+}
+
+}
\ No newline at end of file
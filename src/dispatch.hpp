@@ -0,0 +1,12 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+// Cycles per call for each way of reaching the same trivial callee: inlined lambda, direct call, function pointer, virtual call and std::function
+// Also measures call/return chains deep enough to overflow the return stack buffer
+void benchmarkDispatch(const DurationMeasurer &durationMeasurer, const Report &report);
+
+}
\ No newline at end of file
@@ -0,0 +1,356 @@
+#include "fault.hpp"
+#include "team.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <linux/magic.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#endif
+
+namespace ipc {
+
+#ifdef _WIN32
+
+void benchmarkFault(const DurationMeasurer&, const Report&, const FaultOptions&) {
+	throw std::runtime_error("ipc::benchmarkFault(_WIN32): Page fault costs are only measured on Linux");
+}
+
+#else
+
+// Rows are per base page of x86
+static inline constexpr size_t faultPageSize = 1 << 12;
+static inline constexpr size_t faultHugePageSize = 1 << 21;
+// Mapped by each thread
+static inline constexpr size_t faultRegionSize = 1 << 25;
+static inline constexpr size_t faultPageCount = faultRegionSize / faultPageSize;
+static inline constexpr size_t faultIterationCount = 1 << 3;
+static inline constexpr size_t faultMaxThreadCount = 16;
+
+static volatile uint8_t faultSink;
+
+struct FaultRegion {
+	uint8_t *data = nullptr;
+	size_t size = 0;
+};
+
+// Regions of every worker: a step that throws on one worker leaves the mappings of the others behind, they go with this
+struct FaultRegions {
+	std::vector<FaultRegion> regions;
+
+	FaultRegions(size_t workerCount) :
+		regions(workerCount) {
+	}
+
+	FaultRegions(const FaultRegions &other) = delete;
+	FaultRegions& operator=(const FaultRegions &other) = delete;
+
+	~FaultRegions(void) {
+		for (auto &region : regions) {
+			if (region.data != nullptr)
+				munmap(region.data, region.size);
+		}
+	}
+};
+
+// Mappings of one thread, only the measured step is timed
+struct FaultCase {
+	const char *op;
+	std::function<void (FaultRegion &region, size_t worker)> setup;
+	std::function<void (FaultRegion &region, size_t worker)> measured;
+	std::function<void (FaultRegion &region, size_t worker)> teardown;
+};
+
+// Closed and already unlinked on destruction: nothing is left behind, even on failure
+struct FaultFile {
+	int fd = -1;
+
+	FaultFile(const std::string &directory, size_t size) {
+		auto path = (std::filesystem::path(directory) / "ipc-benchmark-XXXXXX").string();
+		fd = mkstemp(path.data());
+		if (fd < 0)
+			throw std::runtime_error("ipc::FaultFile: Could not create a file in '" + directory + "': " + strerror(errno));
+		unlink(path.c_str());
+
+		// Actual data, so that every page is in the page cache afterwards rather than a hole
+		std::vector<uint8_t> chunk(1 << 20, 0xA5);
+		for (size_t written = 0; written < size;) {
+			auto res = write(fd, chunk.data(), std::min(chunk.size(), size - written));
+			if (res <= 0) {
+				close(fd);
+				throw std::runtime_error(std::string("ipc::FaultFile: write: ") + strerror(errno));
+			}
+			written += static_cast<size_t>(res);
+		}
+	}
+
+	FaultFile(const FaultFile &other) = delete;
+	FaultFile& operator=(const FaultFile &other) = delete;
+
+	~FaultFile(void) {
+		close(fd);
+	}
+};
+
+// File system the file-backed cases fault on, tmpfs and ramfs are memory rather than page cache over a disk
+struct FaultFileSystem {
+	std::string name;
+	bool inMemory;
+};
+
+static FaultFileSystem getFaultFileSystem(const std::string &directory) {
+	struct statfs res;
+	if (statfs(directory.c_str(), &res) != 0)
+		throw std::runtime_error("ipc::getFaultFileSystem: statfs on '" + directory + "': " + strerror(errno));
+	switch (static_cast<unsigned long>(res.f_type)) {
+	case TMPFS_MAGIC:
+		return {"tmpfs", true};
+	case RAMFS_MAGIC:
+		return {"ramfs", true};
+	// Shared by ext2, ext3 and ext4
+	case EXT4_SUPER_MAGIC:
+		return {"ext2/3/4", false};
+	case XFS_SUPER_MAGIC:
+		return {"xfs", false};
+	case BTRFS_SUPER_MAGIC:
+		return {"btrfs", false};
+	case NFS_SUPER_MAGIC:
+		return {"nfs", false};
+	case OVERLAYFS_SUPER_MAGIC:
+		return {"overlayfs", false};
+	default:
+		std::stringstream ss;
+		ss << "0x" << std::hex << static_cast<unsigned long>(res.f_type);
+		return {ss.str(), false};
+	}
+}
+
+static uint8_t* mapFault(size_t size, int flags, int fd = -1, int prot = PROT_READ | PROT_WRITE) {
+	auto res = mmap(nullptr, size, prot, flags, fd, 0);
+	if (res == MAP_FAILED) {
+		std::stringstream ss;
+		ss << "ipc::mapFault: Could not map " << size << " bytes: " << strerror(errno);
+		throw std::runtime_error(ss.str());
+	}
+	return static_cast<uint8_t*>(res);
+}
+
+// Aligned on huge pages, so that every 2 MiB of the region can be a transparent huge page
+static uint8_t* mapFaultHugeAligned(size_t size) {
+	auto raw = mapFault(size + faultHugePageSize, MAP_PRIVATE | MAP_ANONYMOUS);
+	auto aligned = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(raw) + faultHugePageSize - 1) & ~(faultHugePageSize - 1));
+	if (aligned != raw)
+		munmap(raw, static_cast<size_t>(aligned - raw));
+	munmap(aligned + size, static_cast<size_t>(raw + faultHugePageSize - aligned));
+	return aligned;
+}
+
+static void adviseFault(FaultRegion &region, int advice) {
+	if (madvise(region.data, region.size, advice) != 0)
+		throw std::runtime_error(std::string("ipc::adviseFault: madvise: ") + strerror(errno));
+}
+
+static void unmapFault(FaultRegion &region) {
+	munmap(region.data, region.size);
+	region = FaultRegion{};
+}
+
+static void touchFault(uint8_t *data, size_t size) {
+	for (size_t off = 0; off < size; off += faultPageSize)
+		*static_cast<volatile uint8_t*>(data + off) = 1;
+}
+
+static void readFault(const uint8_t *data, size_t size) {
+	uint8_t acc = 0;
+	for (size_t off = 0; off < size; off += faultPageSize)
+		acc += *static_cast<const volatile uint8_t*>(data + off);
+	faultSink = acc;
+}
+
+static std::string readFaultSysfs(const char *path) {
+	std::ifstream input(path, std::ios::in);
+	std::string line;
+	std::getline(input, line);
+	return line;
+}
+
+static void mapFault4K(FaultRegion &region) {
+	region.data = mapFault(faultRegionSize, MAP_PRIVATE | MAP_ANONYMOUS);
+	region.size = faultRegionSize;
+	// Keeps transparent huge pages out of the way whatever the system policy is
+	adviseFault(region, MADV_NOHUGEPAGE);
+}
+
+static std::vector<FaultCase> getFaultCases(size_t maxThreadCount, const std::vector<std::unique_ptr<FaultFile>> &files) {
+	auto touch = [](FaultRegion &region, size_t) {
+		touchFault(region.data, region.size);
+	};
+	auto unmap = [](FaultRegion &region, size_t) {
+		unmapFault(region);
+	};
+
+	std::vector<FaultCase> res = {
+		{"Anonymous 4 KiB first touch", [](FaultRegion &region, size_t) {
+			mapFault4K(region);
+		}, touch, unmap},
+		{"MAP_POPULATE", [](FaultRegion&, size_t) {
+		}, [](FaultRegion &region, size_t) {
+			region.data = mapFault(faultRegionSize, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE);
+			region.size = faultRegionSize;
+		}, unmap},
+		{"MADV_DONTNEED", [](FaultRegion &region, size_t) {
+			mapFault4K(region);
+			touchFault(region.data, region.size);
+		}, [](FaultRegion &region, size_t) {
+			adviseFault(region, MADV_DONTNEED);
+		}, unmap},
+		{"Anonymous refault after MADV_DONTNEED", [](FaultRegion &region, size_t) {
+			mapFault4K(region);
+			touchFault(region.data, region.size);
+			adviseFault(region, MADV_DONTNEED);
+		}, touch, unmap},
+		{"munmap of touched 4 KiB pages", [](FaultRegion &region, size_t) {
+			mapFault4K(region);
+			touchFault(region.data, region.size);
+		}, unmap, [](FaultRegion&, size_t) {
+		}},
+		// Doubling like a growing vector: every step may move the mapping
+		{"mremap growth", [](FaultRegion &region, size_t) {
+			region.data = mapFault(faultPageSize, MAP_PRIVATE | MAP_ANONYMOUS);
+			region.size = faultPageSize;
+			adviseFault(region, MADV_NOHUGEPAGE);
+			touchFault(region.data, region.size);
+		}, [](FaultRegion &region, size_t) {
+			while (region.size < faultRegionSize) {
+				auto grown = mremap(region.data, region.size, region.size * 2, MREMAP_MAYMOVE);
+				if (grown == MAP_FAILED)
+					throw std::runtime_error(std::string("ipc::benchmarkFault: mremap: ") + strerror(errno));
+				region.data = static_cast<uint8_t*>(grown);
+				touchFault(region.data + region.size, region.size);
+				region.size *= 2;
+			}
+		}, unmap},
+		// Minor faults: the file was just written, every page is in the page cache
+		// A fault maps more than its page (fault-around, large folios): rows are per page read, the fault count row tells how many faults it took
+		{"File page cache read", [&files](FaultRegion &region, size_t worker) {
+			region.data = mapFault(faultRegionSize, MAP_SHARED, files[worker]->fd, PROT_READ);
+			region.size = faultRegionSize;
+		}, [](FaultRegion &region, size_t) {
+			readFault(region.data, region.size);
+		}, unmap}
+	};
+
+	if (areTransparentHugePagesEnabled()) {
+		res.emplace_back(FaultCase{"Anonymous THP first touch", [](FaultRegion &region, size_t) {
+			region.data = mapFaultHugeAligned(faultRegionSize);
+			region.size = faultRegionSize;
+			adviseFault(region, MADV_HUGEPAGE);
+		}, touch, unmap});
+	} else
+		std::printf("ipc::benchmarkFault: Transparent huge pages are disabled, skipping them\n");
+
+	auto freeHugePages = readFaultSysfs("/sys/kernel/mm/hugepages/hugepages-2048kB/free_hugepages");
+	auto requiredHugePages = faultRegionSize / faultHugePageSize * maxThreadCount;
+	if (!freeHugePages.empty() && std::stoull(freeHugePages) >= requiredHugePages) {
+		res.emplace_back(FaultCase{"hugetlbfs 2 MiB first touch", [](FaultRegion &region, size_t) {
+			region.data = mapFault(faultRegionSize, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB);
+			region.size = faultRegionSize;
+		}, touch, unmap});
+	} else
+		std::printf("ipc::benchmarkFault: hugetlbfs needs %zu free 2 MiB pages (see /proc/sys/vm/nr_hugepages), skipping it\n", requiredHugePages);
+
+	return res;
+}
+
+static size_t getMinorFaultCount(void) {
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		throw std::runtime_error(std::string("ipc::getMinorFaultCount: getrusage: ") + strerror(errno));
+	return static_cast<size_t>(usage.ru_minflt);
+}
+
+static void benchmarkFaultCase(const DurationMeasurer &durationMeasurer, const Report &report, const FaultCase &faultCase, size_t threadCount) {
+	FaultRegions regions(threadCount);
+	auto step = [&](const std::function<void (FaultRegion &region, size_t worker)> &fn) -> std::function<void (size_t worker)> {
+		return [&regions, &fn](size_t worker) {
+			fn(regions.regions[worker], worker);
+		};
+	};
+	auto setup = step(faultCase.setup);
+	auto measured = step(faultCase.measured);
+	auto teardown = step(faultCase.teardown);
+
+	ThreadTeam team(threadCount);
+	// Every thread counts, read around the measured step only
+	size_t faultCount = 0;
+	// Samples start from fresh mappings: no warmup, there is nothing to warm
+	auto stats = sampleDurations(faultIterationCount, [&]() {
+		team.run(setup);
+		auto faultsBefore = getMinorFaultCount();
+		auto res = durationMeasurer.measure([&]() {
+			team.run(measured);
+		});
+		faultCount += getMinorFaultCount() - faultsBefore;
+		team.run(teardown);
+		return res;
+	}, false) / faultPageCount;
+	auto faultsPerPage = static_cast<double>(faultCount) / static_cast<double>(faultIterationCount * threadCount * faultPageCount);
+
+	std::stringstream execution;
+	execution << threadCount << (threadCount == 1 ? " thread" : " threads");
+	std::printf("%s, Op = %s, %s: avg = %g cycles per 4 KiB page, %g ns, %g minor faults per page (%g MHz)\n", report.meta, faultCase.op, execution.str().c_str(), stats.mean.lengthCycles, stats.mean.lengthSeconds * 1.0e9, faultsPerPage, stats.mean.inferredFrequencyMHz());
+	report.writeRow(faultCase.op, execution.str(), faultRegionSize, stats);
+	report.writeFigure(faultCase.op, execution.str() + " minor faults per page", faultRegionSize, faultsPerPage, "fault");
+}
+
+void benchmarkFault(const DurationMeasurer &durationMeasurer, const Report &report, const FaultOptions &options) {
+	auto maxThreadCount = options.maxThreadCount != 0 ? options.maxThreadCount : std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1), faultMaxThreadCount);
+	std::vector<size_t> threadCounts;
+	for (size_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+		threadCounts.emplace_back(threadCount);
+	threadCounts.emplace_back(maxThreadCount);
+
+	// The system temporary directory is tmpfs on most hosts: page cache faults would be shmem faults there
+	auto directory = options.directory.empty() ? std::string(".") : options.directory;
+	auto fileSystem = getFaultFileSystem(directory);
+	if (fileSystem.inMemory)
+		std::printf("Warning: '%s' is %s, page cache faults are shmem faults there and every thread's %zu MiB file stays in memory. Use --directory to pick a disk-backed one\n\n",
+			directory.c_str(), fileSystem.name.c_str(), faultRegionSize >> 20);
+
+	// Fields must not contain commas
+	std::string meta = report.meta;
+	meta += "; Fault files on " + fileSystem.name + " (" + std::filesystem::absolute(directory).string() + ")";
+	// debugfs, only readable by root
+	auto faultAroundBytes = readFaultSysfs("/sys/kernel/debug/fault_around_bytes");
+	meta += "; fault_around_bytes = " + (faultAroundBytes.empty() ? std::string("unknown") : faultAroundBytes);
+	std::replace(meta.begin(), meta.end(), ',', ';');
+	auto faultReport = report.withMeta(meta.c_str());
+	std::printf("%s\n\n", meta.c_str());
+
+	std::vector<std::unique_ptr<FaultFile>> files;
+	for (size_t i = 0; i < maxThreadCount; i++)
+		files.emplace_back(std::make_unique<FaultFile>(directory, faultRegionSize));
+
+	for (auto &faultCase : getFaultCases(maxThreadCount, files)) {
+		for (auto threadCount : threadCounts)
+			benchmarkFaultCase(durationMeasurer, faultReport, faultCase, threadCount);
+		std::printf("\n");
+	}
+}
+
+#endif
+
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+struct FaultOptions {
+	// Thread counts go 1, 2, 4.. up to this one. 0 is every logical processor, at most 16
+	size_t maxThreadCount = 0;
+	// Where the file-backed cases create their temporary files, the working directory otherwise
+	std::string directory;
+};
+
+// Cycles per 4 KiB page of populating memory: anonymous first touch (4 KiB pages, transparent huge pages, hugetlbfs),
+// MAP_POPULATE, MADV_DONTNEED and the refault after it, mremap growth and page cache reads of a file mapping
+// Rows come with the minor faults per page they took: fault-around and large folios map more than a page per fault
+// Every thread works on its own mappings of the same process, thread counts expose mmap_lock contention. Linux only
+void benchmarkFault(const DurationMeasurer &durationMeasurer, const Report &report, const FaultOptions &options);
+
+}
\ No newline at end of file
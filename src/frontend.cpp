@@ -0,0 +1,242 @@
+#include "frontend.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace ipc {
+
+static inline constexpr size_t frontendMinSize = 1 << 10;
+static inline constexpr size_t frontendPageSize = 1 << 12;
+static inline constexpr size_t frontendHugePageSize = 1 << 21;
+static inline constexpr size_t frontendLineSize = 64;
+// Where branch targets start within their line: past 0, every block straddles two lines
+static inline constexpr size_t frontendTargetOffsets[] = {0, 16, 32, 48};
+// Mapped past the footprint, so that the last block still fits at the largest offset and every offset runs as many blocks
+static inline constexpr size_t frontendTargetSlack = frontendLineSize;
+// Every sample executes at least this many instructions, calling small footprints repeatedly
+static inline constexpr size_t frontendInstructionsPerSample = 1 << 20;
+static inline constexpr size_t frontendIterationCount = 1 << 4;
+
+// 4-byte nop (nopl 0(%rax)): no dependency and no execution port, so that only fetch, decode and rename bound IPC, however wide the core
+// Adds would leave the plateau to the count of integer ALUs (4 on Zen 4) and, with caller-saved registers only, to 7 chains at most
+static inline constexpr uint8_t frontendNop[] = {0x0F, 0x1F, 0x40, 0x00};
+static inline constexpr size_t frontendNopSize = sizeof(frontendNop);
+static inline constexpr size_t frontendJmpSize = 5;
+static inline constexpr uint8_t frontendRet = 0xC3;
+static inline constexpr uint8_t frontendInt3 = 0xCC;
+
+using FrontendFn = void (*)(void);
+
+// Read and write while generating, read and execute once sealed
+class CodeBuffer {
+	uint8_t *m_raw = nullptr;
+	size_t m_rawSize = 0;
+
+public:
+	uint8_t *data = nullptr;
+	size_t size = 0;
+
+	CodeBuffer(size_t size, bool hugePages) :
+		size(size) {
+	#ifdef _WIN32
+		if (hugePages)
+			throw std::runtime_error("ipc::CodeBuffer(_WIN32): Huge pages are not supported for generated code");
+		m_rawSize = size + frontendTargetSlack;
+		m_raw = static_cast<uint8_t*>(VirtualAlloc(nullptr, m_rawSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+		if (m_raw == nullptr) {
+			std::stringstream ss;
+			ss << "ipc::CodeBuffer(_WIN32): VirtualAlloc of " << size << " bytes failed with error " << GetLastError();
+			throw std::runtime_error(ss.str());
+		}
+		data = m_raw;
+	#else
+		// Aligned on huge pages and advised in whole ones, so that even the last partial 2 MiB of code can be a transparent huge page
+		auto advisedSize = hugePages ? (size + frontendTargetSlack + frontendHugePageSize - 1) & ~(frontendHugePageSize - 1) : size + frontendTargetSlack;
+		m_rawSize = hugePages ? advisedSize + frontendHugePageSize : advisedSize;
+		auto raw = mmap(nullptr, m_rawSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (raw == MAP_FAILED) {
+			std::stringstream ss;
+			ss << "ipc::CodeBuffer: Could not map " << size << " bytes: " << strerror(errno);
+			throw std::runtime_error(ss.str());
+		}
+		m_raw = static_cast<uint8_t*>(raw);
+		data = hugePages ? reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(m_raw) + frontendHugePageSize - 1) & ~(frontendHugePageSize - 1)) : m_raw;
+		// Pages are populated while generating, so the advice has to come first
+		if (madvise(data, advisedSize, hugePages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) != 0) {
+			munmap(m_raw, m_rawSize);
+			throw std::runtime_error(std::string("ipc::CodeBuffer: madvise: ") + strerror(errno));
+		}
+	#endif
+		std::memset(data, frontendInt3, size + frontendTargetSlack);
+	}
+
+	CodeBuffer(const CodeBuffer &other) = delete;
+	CodeBuffer& operator=(const CodeBuffer &other) = delete;
+
+	~CodeBuffer(void) {
+	#ifdef _WIN32
+		VirtualFree(m_raw, 0, MEM_RELEASE);
+	#else
+		munmap(m_raw, m_rawSize);
+	#endif
+	}
+
+	// No more writes past this point
+	FrontendFn seal(size_t entry) {
+	#ifdef _WIN32
+		DWORD previous;
+		if (!VirtualProtect(m_raw, m_rawSize, PAGE_EXECUTE_READ, &previous) || !FlushInstructionCache(GetCurrentProcess(), m_raw, m_rawSize)) {
+			std::stringstream ss;
+			ss << "ipc::CodeBuffer::seal(_WIN32): VirtualProtect failed with error " << GetLastError();
+			throw std::runtime_error(ss.str());
+		}
+	#else
+		if (mprotect(m_raw, m_rawSize, PROT_READ | PROT_EXEC) != 0)
+			throw std::runtime_error(std::string("ipc::CodeBuffer::seal: mprotect: ") + strerror(errno));
+		__builtin___clear_cache(reinterpret_cast<char*>(data), reinterpret_cast<char*>(data + size + frontendTargetSlack));
+	#endif
+		return reinterpret_cast<FrontendFn>(data + entry);
+	}
+};
+
+// Returns the instruction count written
+static size_t emitNops(uint8_t *dst, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		std::memcpy(dst + i * frontendNopSize, frontendNop, frontendNopSize);
+	return count;
+}
+
+static void emitJmp(uint8_t *dst, const uint8_t *target) {
+	auto rel = static_cast<int32_t>(target - (dst + frontendJmpSize));
+	dst[0] = 0xE9;
+	std::memcpy(dst + 1, &rel, sizeof(rel));
+}
+
+struct FrontendCode {
+	FrontendFn fn;
+	// Executed by one call, ret included
+	size_t instructionCount;
+};
+
+// Nops all the way, then ret
+static FrontendCode generateStraightLine(CodeBuffer &code) {
+	auto count = (code.size - 1) / frontendNopSize;
+	emitNops(code.data, count);
+	code.data[count * frontendNopSize] = frontendRet;
+	return FrontendCode{
+		.fn = code.seal(0),
+		.instructionCount = count + 1
+	};
+}
+
+// Blocks of nops ending with a jump to the next block, visited in random order: nothing for the next-line prefetcher
+// Blocks start targetOffset bytes into their slot, the last block visited returns instead
+static FrontendCode generateBranchChained(CodeBuffer &code, size_t blockSize, size_t targetOffset = 0) {
+	// Straight-line part of every block fits one cache line, whatever the block stride
+	auto nopCount = (frontendLineSize - frontendJmpSize) / frontendNopSize;
+	// Whatever the offset, the last block spills into the slack at most
+	auto blockCount = code.size / blockSize;
+
+	std::vector<size_t> order(blockCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::mt19937_64 rng(0xF207 + blockSize);
+	std::shuffle(order.begin() + 1, order.end(), rng);
+
+	auto getBlock = [&](size_t i) {
+		return code.data + order[i] * blockSize + targetOffset;
+	};
+	for (size_t i = 0; i < blockCount; i++) {
+		auto block = getBlock(i);
+		emitNops(block, nopCount);
+		auto tail = block + nopCount * frontendNopSize;
+		if (i + 1 < blockCount)
+			emitJmp(tail, getBlock(i + 1));
+		else
+			*tail = frontendRet;
+	}
+	return FrontendCode{
+		.fn = code.seal(order[0] * blockSize + targetOffset),
+		.instructionCount = blockCount * (nopCount + 1)
+	};
+}
+
+struct FrontendPattern {
+	std::string op;
+	const char *execution;
+	// Smallest footprint that holds more than one block
+	size_t minSize;
+	bool hugePages;
+	std::function<FrontendCode (CodeBuffer &code)> generate;
+};
+
+static std::vector<FrontendPattern> getFrontendPatterns(void) {
+	std::vector<FrontendPattern> res = {
+		{"Straight-line nops", "4 KiB pages", frontendMinSize, false, generateStraightLine}
+	};
+	// Same block count and instructions whatever the offset: only the lines fetched per block change
+	for (auto offset : frontendTargetOffsets) {
+		std::stringstream op;
+		op << "Branch-chained cache lines";
+		if (offset != 0)
+			op << " target +" << offset << " B";
+		res.emplace_back(FrontendPattern{op.str(), "4 KiB pages", frontendMinSize, false, [offset](CodeBuffer &code) {
+			return generateBranchChained(code, frontendLineSize, offset);
+		}});
+	}
+	// One line executed per page: iTLB reach rather than cache capacity
+	res.emplace_back(FrontendPattern{"Branch-chained pages", "4 KiB pages", frontendPageSize * 2, false, [](CodeBuffer &code) {
+		return generateBranchChained(code, frontendPageSize);
+	}});
+
+	if (areTransparentHugePagesEnabled()) {
+		res.emplace_back(FrontendPattern{"Straight-line nops", "Transparent huge pages", frontendMinSize, true, generateStraightLine});
+		res.emplace_back(FrontendPattern{"Branch-chained pages", "Transparent huge pages", frontendPageSize * 2, true, [](CodeBuffer &code) {
+			return generateBranchChained(code, frontendPageSize);
+		}});
+	} else
+		std::printf("ipc::benchmarkFrontend: Transparent huge pages are disabled or unsupported, skipping them\n\n");
+	return res;
+}
+
+static void benchmarkFrontendFootprint(const DurationMeasurer &durationMeasurer, const Report &report, const FrontendPattern &pattern, size_t size) {
+	CodeBuffer code(size, pattern.hugePages);
+	auto generated = pattern.generate(code);
+	auto repeatCount = std::max<size_t>(frontendInstructionsPerSample / generated.instructionCount, 1);
+
+	auto perInstruction = sampleDurations(frontendIterationCount, [&]() {
+		return durationMeasurer.measure([&]() {
+			for (size_t i = 0; i < repeatCount; i++)
+				generated.fn();
+		});
+	}) / (generated.instructionCount * repeatCount);
+
+	std::printf("%s, Op = %s, %s, footprint = %zu bytes: avg = %g cycles per instruction, %g IPC (%g MHz)\n", report.meta, pattern.op.c_str(), pattern.execution, size,
+		perInstruction.mean.lengthCycles, 1.0 / perInstruction.mean.lengthCycles, perInstruction.mean.inferredFrequencyMHz());
+	report.writeRow(pattern.op, pattern.execution, size, perInstruction);
+}
+
+void benchmarkFrontend(const DurationMeasurer &durationMeasurer, const Report &report, const FrontendOptions &options) {
+	if (options.maxSize < frontendMinSize)
+		throw std::runtime_error("ipc::benchmarkFrontend: Largest footprint must be at least 1 KiB");
+
+	for (auto &pattern : getFrontendPatterns()) {
+		// Power of two steps and the midpoints between them, to place the cliffs more precisely
+		for (size_t size = pattern.minSize; size <= options.maxSize; size *= 2) {
+			benchmarkFrontendFootprint(durationMeasurer, report, pattern, size);
+			if (size + size / 2 <= options.maxSize)
+				benchmarkFrontendFootprint(durationMeasurer, report, pattern, size + size / 2);
+		}
+		std::printf("\n");
+	}
+}
+
+}
\ No newline at end of file
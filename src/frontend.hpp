@@ -0,0 +1,18 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+struct FrontendOptions {
+	// Largest generated code footprint, in bytes
+	size_t maxSize = static_cast<size_t>(1) << 25;
+};
+
+// Cycles per instruction and IPC of generated x86-64 code over its footprint, from 1 KiB to options.maxSize
+// Straight-line code, branch-chained cache lines in random order (branch targets at several offsets within their line) and one block per page (with and without huge pages)
+// The cliffs are where the uop cache, L1i, L2 and iTLB stop holding the code
+void benchmarkFrontend(const DurationMeasurer &durationMeasurer, const Report &report, const FrontendOptions &options);
+
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+// Public header of libipc-benchmark.a: embed the measurement methodology of ipc-benchmark in another binary
+//
+// ipc::Session session("Release = my-service_v1.2.3", "./report.csv");
+// ipc::Suite suite;
+// suite.add(ipc::BenchmarkCase{
+// 	.op = "Parse request",
+// 	.execution = "Sequentially",
+// 	.bufferSize = input.size(),
+// 	.opCount = requestCount,
+// 	.run = [&]() { parseAll(input); }
+// });
+// suite.run(session.getDurationMeasurer(), session.getReport());
+
+#include "clock.hpp"
+#include "benchmark.hpp"
+#include "sampling.hpp"
+#include "report.hpp"
+#include "suite.hpp"
\ No newline at end of file
@@ -0,0 +1,608 @@
+#include "kernel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <filesystem>
+#include <fstream>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <time.h>
+#endif
+
+namespace ipc {
+
+#ifdef _WIN32
+
+void benchmarkKernel(const DurationMeasurer&, const Report&, const KernelOptions&) {
+	throw std::runtime_error("ipc::benchmarkKernel(_WIN32): Kernel crossing costs are only measured on Linux");
+}
+
+#else
+
+static inline constexpr size_t kernelCallCount = 1 << 12;
+static inline constexpr size_t kernelCallIterationCount = 1 << 8;
+static inline constexpr size_t kernelRoundTripCount = 1 << 10;
+static inline constexpr size_t kernelRoundTripIterationCount = 1 << 5;
+
+// Message values of round trips
+static inline constexpr uint64_t kernelPing = 1;
+static inline constexpr uint64_t kernelStop = 2;
+// How long the other side of a round trip gets to start, and to leave once told to
+static inline constexpr auto kernelChildTimeout = std::chrono::seconds(10);
+
+static volatile long kernelSink;
+
+// Restores the affinity of the calling thread, round trips pin it
+class AffinityGuard
+{
+	cpu_set_t m_original;
+
+public:
+	AffinityGuard(void) {
+		if (sched_getaffinity(0, sizeof(m_original), &m_original) != 0)
+			throw std::runtime_error(std::string("ipc::AffinityGuard: sched_getaffinity: ") + strerror(errno));
+	}
+
+	AffinityGuard(const AffinityGuard &other) = delete;
+	AffinityGuard& operator=(const AffinityGuard &other) = delete;
+
+	const cpu_set_t& getOriginal(void) const {
+		return m_original;
+	}
+
+	~AffinityGuard(void) {
+		sched_setaffinity(0, sizeof(m_original), &m_original);
+	}
+};
+
+// Writes to a pipe or socket whose reader left fail with EPIPE for the duration, instead of killing the process
+class SigpipeGuard
+{
+	struct sigaction m_original;
+
+public:
+	SigpipeGuard(void) {
+		struct sigaction ignore{};
+		ignore.sa_handler = SIG_IGN;
+		if (sigaction(SIGPIPE, &ignore, &m_original) != 0)
+			throw std::runtime_error(std::string("ipc::SigpipeGuard: sigaction: ") + strerror(errno));
+	}
+
+	SigpipeGuard(const SigpipeGuard &other) = delete;
+	SigpipeGuard& operator=(const SigpipeGuard &other) = delete;
+
+	~SigpipeGuard(void) {
+		sigaction(SIGPIPE, &m_original, nullptr);
+	}
+};
+
+// Fields must not contain commas: they are turned into semicolons
+static std::string getKernelMeta(const char *meta) {
+	std::stringstream ss;
+	ss << meta;
+
+	utsname name;
+	if (uname(&name) == 0)
+		ss << "; Kernel = " << name.release;
+
+	std::vector<std::filesystem::path> paths;
+	std::error_code error;
+	for (auto &entry : std::filesystem::directory_iterator("/sys/devices/system/cpu/vulnerabilities", error))
+		paths.emplace_back(entry.path());
+	std::sort(paths.begin(), paths.end());
+
+	ss << "; Mitigations =";
+	if (paths.empty())
+		ss << " unknown";
+	for (size_t i = 0; i < paths.size(); i++) {
+		std::ifstream input(paths[i], std::ios::in);
+		std::string state;
+		std::getline(input, state);
+		ss << (i == 0 ? " " : " | ") << paths[i].filename().string() << ": " << state;
+	}
+
+	auto res = ss.str();
+	std::replace(res.begin(), res.end(), ',', ';');
+	return res;
+}
+
+static long futex(std::atomic<uint32_t> &word, int op, uint32_t value) {
+	return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, value, nullptr, nullptr, 0);
+}
+
+static void writeKernelMessage(int fd, uint64_t value, size_t size) {
+	// Little endian: single byte messages are the low byte of value
+	if (write(fd, &value, size) != static_cast<ssize_t>(size))
+		throw std::runtime_error(std::string("ipc::writeKernelMessage: write: ") + strerror(errno));
+}
+
+static uint64_t readKernelMessage(int fd, size_t size) {
+	uint64_t value = 0;
+	auto res = read(fd, &value, size);
+	if (res == 0)
+		throw std::runtime_error("ipc::readKernelMessage: The other side closed the channel");
+	if (res != static_cast<ssize_t>(size))
+		throw std::runtime_error(std::string("ipc::readKernelMessage: read: ") + strerror(errno));
+	return value;
+}
+
+// Reaps a forked child from its own thread, which is how its death is noticed while the parent is blocked on it
+// Lost is `void (void)`: called when the child leaves before being told to, must wake the parent up
+class ChildWatch
+{
+	pid_t m_child;
+	std::atomic<bool> m_exited{false};
+	std::atomic<bool> m_stopping{false};
+	std::thread m_thread;
+
+public:
+	template <typename Lost>
+	ChildWatch(pid_t child, Lost &&lost) :
+		m_child(child),
+		m_thread([this, lost]() {
+			while (waitpid(m_child, nullptr, 0) < 0 && errno == EINTR);
+			m_exited.store(true, std::memory_order_release);
+			if (!m_stopping.load(std::memory_order_acquire))
+				lost();
+		})
+	{
+	}
+
+	ChildWatch(const ChildWatch &other) = delete;
+	ChildWatch& operator=(const ChildWatch &other) = delete;
+
+	// Gives the child some time to leave once told to, then kills it
+	void finish(void) {
+		m_stopping.store(true, std::memory_order_release);
+		auto deadline = std::chrono::steady_clock::now() + kernelChildTimeout;
+		while (!m_exited.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		if (!m_exited.load(std::memory_order_acquire)) {
+			std::fprintf(stderr, "ipc::ChildWatch: Child %d did not leave in time, killing it\n", static_cast<int>(m_child));
+			kill(m_child, SIGKILL);
+		}
+		m_thread.join();
+	}
+
+	~ChildWatch(void) {
+		if (m_thread.joinable()) {
+			m_stopping.store(true, std::memory_order_release);
+			kill(m_child, SIGKILL);
+			m_thread.join();
+		}
+	}
+};
+
+// The child writes a single byte to ready once pinned: end of file means it failed, see its stderr
+static void waitForChild(pid_t child, int ready) {
+	auto deadline = std::chrono::steady_clock::now() + kernelChildTimeout;
+	while (true) {
+		pollfd entry{.fd = ready, .events = POLLIN, .revents = 0};
+		auto res = poll(&entry, 1, 100);
+		if (res < 0 && errno != EINTR)
+			throw std::runtime_error(std::string("ipc::waitForChild: poll: ") + strerror(errno));
+		if (res > 0) {
+			char byte;
+			if (read(ready, &byte, 1) == 1)
+				return;
+			waitpid(child, nullptr, 0);
+			throw std::runtime_error("ipc::waitForChild: Child failed before being ready");
+		}
+		// Nothing to read yet, the child may still have died without closing its end (e.g. stopped)
+		int status;
+		if (waitpid(child, &status, WNOHANG) == child)
+			throw std::runtime_error("ipc::waitForChild: Child left before being ready");
+		if (std::chrono::steady_clock::now() >= deadline) {
+			kill(child, SIGKILL);
+			waitpid(child, nullptr, 0);
+			throw std::runtime_error("ipc::waitForChild: Child was not ready in time");
+		}
+	}
+}
+
+// Fn is `void (void)`, called back to back
+template <typename Fn>
+static Statistics measureKernelCalls(const DurationMeasurer &durationMeasurer, Fn &&fn) {
+	return sampleDurations(kernelCallIterationCount, [&]() {
+		return durationMeasurer.measure([&]() {
+			for (size_t i = 0; i < kernelCallCount; i++)
+				fn();
+		});
+	}) / kernelCallCount;
+}
+
+// Ping is `void (void)`: one message to the other side and back
+template <typename Ping>
+static Statistics measureRoundTrips(const DurationMeasurer &durationMeasurer, Ping &&ping) {
+	return sampleDurations(kernelRoundTripIterationCount, [&]() {
+		return durationMeasurer.measure([&]() {
+			for (size_t i = 0; i < kernelRoundTripCount; i++)
+				ping();
+		});
+	}) / kernelRoundTripCount;
+}
+
+enum class KernelChannelKind {
+	Pipe,
+	Eventfd,
+	UnixSocket
+};
+
+static const char* toString(KernelChannelKind kind) {
+	switch (kind) {
+	case KernelChannelKind::Pipe:
+		return "Pipe";
+	case KernelChannelKind::Eventfd:
+		return "eventfd";
+	case KernelChannelKind::UnixSocket:
+		return "Unix socket";
+	}
+	return "Unknown";
+}
+
+// Created for a single child: each side closes the descriptors only the other one uses, so that the end of either is seen as end of file
+class KernelChannel
+{
+	std::vector<int> m_fds;
+
+	// Descriptors of these ends not used by the other side
+	std::vector<int> getOnly(int read, int write, int otherRead, int otherWrite) const {
+		std::vector<int> res;
+		for (auto fd : {read, write}) {
+			if (fd != otherRead && fd != otherWrite && std::find(res.begin(), res.end(), fd) == res.end())
+				res.emplace_back(fd);
+		}
+		return res;
+	}
+
+	void closeOnly(const std::vector<int> &fds) {
+		for (auto fd : fds) {
+			close(fd);
+			std::erase(m_fds, fd);
+		}
+	}
+
+public:
+	int parentRead = -1;
+	int parentWrite = -1;
+	int childRead = -1;
+	int childWrite = -1;
+	// eventfd moves 8-byte counters, the others single bytes
+	size_t messageSize = 1;
+
+	KernelChannel(KernelChannelKind kind) {
+		bool ok = true;
+		switch (kind) {
+		case KernelChannelKind::Pipe: {
+			int toChild[2] = {-1, -1}, toParent[2] = {-1, -1};
+			ok = pipe(toChild) == 0 && pipe(toParent) == 0;
+			m_fds = {toChild[0], toChild[1], toParent[0], toParent[1]};
+			parentRead = toParent[0];
+			parentWrite = toChild[1];
+			childRead = toChild[0];
+			childWrite = toParent[1];
+			break;
+		}
+		case KernelChannelKind::Eventfd: {
+			// Both sides hold both counters: there is no end to close, the parent is woken up by hand if the child leaves
+			auto toChild = eventfd(0, 0);
+			auto toParent = eventfd(0, 0);
+			ok = toChild >= 0 && toParent >= 0;
+			m_fds = {toChild, toParent};
+			parentRead = childWrite = toParent;
+			parentWrite = childRead = toChild;
+			messageSize = 8;
+			break;
+		}
+		case KernelChannelKind::UnixSocket: {
+			int sockets[2] = {-1, -1};
+			ok = socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0;
+			m_fds = {sockets[0], sockets[1]};
+			parentRead = parentWrite = sockets[0];
+			childRead = childWrite = sockets[1];
+			break;
+		}
+		}
+		std::erase(m_fds, -1);
+		if (!ok) {
+			std::string error = strerror(errno);
+			for (auto fd : m_fds)
+				close(fd);
+			throw std::runtime_error(std::string("ipc::KernelChannel: Could not create a ") + toString(kind) + " channel: " + error);
+		}
+	}
+
+	KernelChannel(const KernelChannel &other) = delete;
+	KernelChannel& operator=(const KernelChannel &other) = delete;
+
+	// Right after forking, on each side
+	void keepParentEnds(void) {
+		closeOnly(getOnly(childRead, childWrite, parentRead, parentWrite));
+	}
+
+	void keepChildEnds(void) {
+		closeOnly(getOnly(parentRead, parentWrite, childRead, childWrite));
+	}
+
+	// Pipes and sockets see end of file, an eventfd counter has to be bumped past a ping
+	void wakeParent(void) const {
+		if (parentRead == childWrite)
+			writeKernelMessage(parentRead, kernelStop, messageSize);
+	}
+
+	~KernelChannel(void) {
+		for (auto fd : m_fds)
+			close(fd);
+	}
+};
+
+// Echo is `bool (void)`, run in a forked child pinned to childCore until it returns false. Stop is `void (void)`, tells the child to leave
+// Lost is `void (void)`, called from another thread if the child leaves early: it must wake ping up so that it throws
+// channel: optional, each side only keeps its own ends after forking
+template <typename Ping, typename Echo, typename Stop, typename Lost>
+static Statistics measureProcessRoundTrips(const DurationMeasurer &durationMeasurer, size_t parentCore, size_t childCore, Ping &&ping, Echo &&echo, Stop &&stop, Lost &&lost, KernelChannel *channel = nullptr) {
+	int ready[2];
+	if (pipe(ready) != 0)
+		throw std::runtime_error(std::string("ipc::measureProcessRoundTrips: pipe: ") + strerror(errno));
+	auto child = fork();
+	if (child < 0) {
+		close(ready[0]);
+		close(ready[1]);
+		throw std::runtime_error(std::string("ipc::measureProcessRoundTrips: fork: ") + strerror(errno));
+	}
+	if (child == 0) {
+		close(ready[0]);
+		if (channel != nullptr)
+			channel->keepChildEnds();
+		// Nothing of the parent must be torn down from here (e.g. the measurer), hence _exit
+		try {
+			pinThreadToCore(childCore);
+			char byte = 1;
+			if (write(ready[1], &byte, 1) != 1)
+				_exit(1);
+			close(ready[1]);
+			while (echo());
+		} catch (const std::exception &e) {
+			std::fprintf(stderr, "ipc::measureProcessRoundTrips: Child: %s\n", e.what());
+			_exit(1);
+		}
+		_exit(0);
+	}
+
+	close(ready[1]);
+	if (channel != nullptr)
+		channel->keepParentEnds();
+	try {
+		waitForChild(child, ready[0]);
+	} catch (const std::exception&) {
+		close(ready[0]);
+		throw;
+	}
+	close(ready[0]);
+
+	ChildWatch watch(child, lost);
+	pinThreadToCore(parentCore);
+	auto res = measureRoundTrips(durationMeasurer, ping);
+	stop();
+	watch.finish();
+	return res;
+}
+
+static Statistics measureChannel(const DurationMeasurer &durationMeasurer, KernelChannelKind kind, size_t parentCore, size_t childCore) {
+	KernelChannel channel(kind);
+	return measureProcessRoundTrips(durationMeasurer, parentCore, childCore, [&]() {
+		writeKernelMessage(channel.parentWrite, kernelPing, channel.messageSize);
+		if (readKernelMessage(channel.parentRead, channel.messageSize) != kernelPing)
+			throw std::runtime_error("ipc::measureChannel: Child left during the round trips");
+	}, [&]() {
+		if (readKernelMessage(channel.childRead, channel.messageSize) != kernelPing)
+			return false;
+		writeKernelMessage(channel.childWrite, kernelPing, channel.messageSize);
+		return true;
+	}, [&]() {
+		writeKernelMessage(channel.parentWrite, kernelStop, channel.messageSize);
+	}, [&]() {
+		channel.wakeParent();
+	}, &channel);
+}
+
+// Both mailboxes on their own line, so that only the handoff itself moves lines between cores
+struct SpinMailboxes {
+	alignas(64) std::atomic<uint64_t> ping;
+	alignas(64) std::atomic<uint64_t> pong;
+};
+
+static Statistics measureSpin(const DurationMeasurer &durationMeasurer, size_t parentCore, size_t childCore) {
+	auto mapping = mmap(nullptr, sizeof(SpinMailboxes), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED)
+		throw std::runtime_error(std::string("ipc::measureSpin: mmap: ") + strerror(errno));
+	auto mailboxes = new (mapping) SpinMailboxes{};
+
+	uint64_t sent = 0, seen = 0;
+	std::atomic<bool> lost{false};
+	try {
+		auto res = measureProcessRoundTrips(durationMeasurer, parentCore, childCore, [&]() {
+			mailboxes->ping.store(++sent, std::memory_order_release);
+			while (mailboxes->pong.load(std::memory_order_acquire) != sent) {
+				if (lost.load(std::memory_order_relaxed))
+					throw std::runtime_error("ipc::measureSpin: Child left during the round trips");
+				_mm_pause();
+			}
+		}, [&]() {
+			uint64_t value;
+			while ((value = mailboxes->ping.load(std::memory_order_acquire)) == seen)
+				_mm_pause();
+			if (value == UINT64_MAX)
+				return false;
+			seen = value;
+			mailboxes->pong.store(value, std::memory_order_release);
+			return true;
+		}, [&]() {
+			mailboxes->ping.store(UINT64_MAX, std::memory_order_release);
+		}, [&]() {
+			lost.store(true, std::memory_order_relaxed);
+		});
+		munmap(mapping, sizeof(SpinMailboxes));
+		return res;
+	} catch (const std::exception&) {
+		munmap(mapping, sizeof(SpinMailboxes));
+		throw;
+	}
+}
+
+// Between two threads of this process: wait and wake are the whole exchange
+static Statistics measureFutex(const DurationMeasurer &durationMeasurer, size_t parentCore, size_t childCore) {
+	// Futex words are 32-bit
+	alignas(64) std::atomic<uint32_t> ping{0};
+	alignas(64) std::atomic<uint32_t> pong{0};
+	std::atomic<bool> stop{false};
+	std::atomic<bool> ready{false};
+	std::atomic<bool> failed{false};
+
+	std::exception_ptr childError;
+	std::thread child([&]() {
+		try {
+			pinThreadToCore(childCore);
+			ready.store(true, std::memory_order_release);
+			uint32_t seen = 0;
+			while (true) {
+				uint32_t value;
+				while ((value = ping.load(std::memory_order_acquire)) == seen)
+					futex(ping, FUTEX_WAIT_PRIVATE, seen);
+				if (stop.load(std::memory_order_acquire))
+					return;
+				seen = value;
+				pong.store(value, std::memory_order_release);
+				futex(pong, FUTEX_WAKE_PRIVATE, 1);
+			}
+		} catch (...) {
+			childError = std::current_exception();
+			// Wakes the parent up wherever it waits: pong never reaches this value otherwise
+			failed.store(true, std::memory_order_release);
+			pong.store(UINT32_MAX, std::memory_order_release);
+			futex(pong, FUTEX_WAKE_PRIVATE, 1);
+		}
+	});
+
+	uint32_t sent = 0;
+	auto leave = [&]() {
+		stop.store(true, std::memory_order_release);
+		ping.fetch_add(1, std::memory_order_release);
+		futex(ping, FUTEX_WAKE_PRIVATE, 1);
+		child.join();
+	};
+	try {
+		pinThreadToCore(parentCore);
+		while (!ready.load(std::memory_order_acquire) && !failed.load(std::memory_order_acquire))
+			std::this_thread::yield();
+		if (failed.load(std::memory_order_acquire)) {
+			child.join();
+			std::rethrow_exception(childError);
+		}
+		auto res = measureRoundTrips(durationMeasurer, [&]() {
+			ping.store(++sent, std::memory_order_release);
+			futex(ping, FUTEX_WAKE_PRIVATE, 1);
+			uint32_t value;
+			while ((value = pong.load(std::memory_order_acquire)) != sent) {
+				if (failed.load(std::memory_order_acquire))
+					throw std::runtime_error("ipc::measureFutex: Child thread failed during the round trips");
+				futex(pong, FUTEX_WAIT_PRIVATE, value);
+			}
+		});
+		leave();
+		if (childError)
+			std::rethrow_exception(childError);
+		return res;
+	} catch (const std::exception&) {
+		if (child.joinable())
+			leave();
+		if (childError)
+			std::rethrow_exception(childError);
+		throw;
+	}
+}
+
+static void writeKernelRow(const Report &report, const std::string &op, const std::string &execution, const Statistics &stats, const char *unit) {
+	std::printf("Op = %s %s: avg = %g cycles per %s, %g ns (%g MHz)\n", op.c_str(), execution.c_str(), stats.mean.lengthCycles, unit, stats.mean.lengthSeconds * 1.0e9, stats.mean.inferredFrequencyMHz());
+	report.writeRow(op, execution, 0, stats);
+}
+
+void benchmarkKernel(const DurationMeasurer &durationMeasurer, const Report &baseReport, const KernelOptions &options) {
+	auto meta = getKernelMeta(baseReport.meta);
+	std::printf("%s\n", meta.c_str());
+	auto report = baseReport.withMeta(meta.c_str());
+
+	AffinityGuard affinity;
+	SigpipeGuard sigpipe;
+	std::vector<size_t> allowed;
+	for (size_t core = 0; core < CPU_SETSIZE; core++) {
+		if (CPU_ISSET(core, &affinity.getOriginal()))
+			allowed.emplace_back(core);
+	}
+	auto cores = options.cores.value_or(std::make_pair(allowed.at(0), allowed.size() > 1 ? allowed[1] : allowed[0]));
+	// Checked before anything is spawned: a side that cannot be pinned would leave the other one waiting
+	for (auto core : {cores.first, cores.second}) {
+		if (core >= CPU_SETSIZE || !CPU_ISSET(core, &affinity.getOriginal())) {
+			std::stringstream ss;
+			ss << "ipc::benchmarkKernel: Core " << core << " is not in the affinity mask of this process (allowed:";
+			for (auto allowedCore : allowed)
+				ss << " " << allowedCore;
+			ss << ")";
+			throw std::runtime_error(ss.str());
+		}
+	}
+	std::printf("ipc::benchmarkKernel: Round trips between cores %zu and %zu\n\n", cores.first, cores.second);
+
+	// The remaining measurements all stay on the first core, as round trips leave it
+	pinThreadToCore(cores.first);
+
+	writeKernelRow(report, "Null syscall (getppid)", "Sequentially", measureKernelCalls(durationMeasurer, []() {
+		kernelSink = syscall(SYS_getppid);
+	}), "call");
+	writeKernelRow(report, "clock_gettime vDSO", "Sequentially", measureKernelCalls(durationMeasurer, []() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		kernelSink = ts.tv_nsec;
+	}), "call");
+	writeKernelRow(report, "clock_gettime syscall", "Sequentially", measureKernelCalls(durationMeasurer, []() {
+		timespec ts;
+		syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+		kernelSink = ts.tv_nsec;
+	}), "call");
+	std::printf("\n");
+
+	std::vector<std::pair<const char*, std::pair<size_t, size_t>>> placements = {{"Round trip same core", {cores.first, cores.first}}};
+	if (cores.first != cores.second)
+		placements.emplace_back("Round trip cross core", cores);
+	else
+		std::printf("ipc::benchmarkKernel: A single core is available, skipping cross core round trips and the spin ping-pong\n");
+
+	for (auto &[execution, placement] : placements) {
+		writeKernelRow(report, "Futex wake between threads", execution, measureFutex(durationMeasurer, placement.first, placement.second), "round trip");
+		for (auto kind : {KernelChannelKind::Pipe, KernelChannelKind::Eventfd, KernelChannelKind::UnixSocket})
+			writeKernelRow(report, std::string(toString(kind)) + " between processes", execution, measureChannel(durationMeasurer, kind, placement.first, placement.second), "round trip");
+		// Spinning on a shared core only measures the scheduler quantum
+		if (placement.first != placement.second)
+			writeKernelRow(report, "Shared memory spin between processes", execution, measureSpin(durationMeasurer, placement.first, placement.second), "round trip");
+		std::printf("\n");
+	}
+}
+
+#endif
+
+}
\ No newline at end of file
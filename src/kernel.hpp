@@ -0,0 +1,21 @@
+#pragma once
+
+#include <optional>
+#include <utility>
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+struct KernelOptions {
+	// Cores the two sides of round trips are pinned to, the first two allowed ones otherwise
+	std::optional<std::pair<size_t, size_t>> cores;
+};
+
+// Cycles per kernel crossing: null syscall, vDSO clock_gettime, futex wakeups between pinned threads,
+// pipe, eventfd and Unix socket round trips between processes, and a shared memory spin ping-pong for comparison
+// Round trips are measured with both sides on the same core (context switches) and on two cores (wakeups)
+// Rows carry the kernel release and the active CPU vulnerability mitigations in their meta column. Linux only
+void benchmarkKernel(const DurationMeasurer &durationMeasurer, const Report &report, const KernelOptions &options);
+
+}
\ No newline at end of file
@@ -1,25 +1,39 @@
 #include <cstdio>
 #include <fstream>
 #include <cstdlib>
-#include "clock.hpp"
-#include "benchmark.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <sstream>
+#include "ipc-benchmark.hpp"
 #include "data.hpp"
+#include "prefetch.hpp"
+#include "branch.hpp"
+#include "dispatch.hpp"
+#include "frontend.hpp"
+#include "roofline.hpp"
+#include "compare.hpp"
+#include "probe.hpp"
+#include "kernel.hpp"
+#include "alloc.hpp"
+#include "fault.hpp"
 
 static inline constexpr auto meta = "Release = ipc-benchmark_v2.0.0";
 
 // Op is `T (T a, T b)`
 template <typename T, size_t BufferSize, typename Op>
-static inline void benchmarkOp(const ipc::DurationMeasurer &durationMeasurer, const ipc::Buffer &srcBuffer, ipc::Buffer &buffer, Op &&op, const char *opStr, const char *cpuInfo, std::ostream &output) {
+static inline void benchmarkOp(const ipc::DurationMeasurer &durationMeasurer, const ipc::Buffer &srcBuffer, ipc::Buffer &buffer, Op &&op, const char *opStr, const ipc::Report &report) {
 	{
 		auto pipelined = ipc::computeCyleCountPerOpPipelined<T, BufferSize>(durationMeasurer, srcBuffer, buffer, std::forward<Op>(op));
-		std::printf("%s, Op = %s pipelined, buffer size = %zu bytes: avg = %g cycles per operation (%g MHz)\n", meta, opStr, BufferSize, pipelined.lengthCycles, pipelined.inferredFrequencyMHz());
-		output << meta << ", " << cpuInfo << ", " << opStr << ", Pipelined, " << BufferSize << ", " << pipelined.lengthCycles << ", " << pipelined.inferredFrequencyMHz() << std::endl;
+		std::printf("%s, Op = %s pipelined, buffer size = %zu bytes: avg = %g cycles per operation (%g MHz)\n", meta, opStr, BufferSize, pipelined.mean.lengthCycles, pipelined.mean.inferredFrequencyMHz());
+		report.writeRow(opStr, "Pipelined", BufferSize, pipelined);
 	}
 
 	{
 		auto sequentially = ipc::computeCyleCountPerOpSequentially<T, BufferSize>(durationMeasurer, srcBuffer, buffer, std::forward<Op>(op));
-		std::printf("%s, Op = %s sequentially, buffer size = %zu bytes: avg = %g cycles per operation (%g MHz)\n", meta, opStr, BufferSize, sequentially.lengthCycles, sequentially.inferredFrequencyMHz());
-		output << meta << ", " << cpuInfo << ", " << opStr << ", Sequentially, " << BufferSize << ", " << sequentially.lengthCycles << ", " << sequentially.inferredFrequencyMHz() << std::endl;
+		std::printf("%s, Op = %s sequentially, buffer size = %zu bytes: avg = %g cycles per operation (%g MHz)\n", meta, opStr, BufferSize, sequentially.mean.lengthCycles, sequentially.mean.inferredFrequencyMHz());
+		report.writeRow(opStr, "Sequentially", BufferSize, sequentially);
 	}
 }
 
@@ -29,92 +43,375 @@ static auto buffer = ipc::Buffer(maxBufferSize);
 static auto srcBuffer = ipc::Buffer(maxBufferSize);
 
 template <size_t BufferSize>
-static inline void benchmark(const ipc::DurationMeasurer &durationMeasurer, const char *cpuInfo, std::ostream &output) {
+static inline void benchmark(const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
 	static_assert(BufferSize <= maxBufferSize, "BufferSize must not exceed maxBufferSize");
 
 	ipc::writeU16Data(srcBuffer, BufferSize);
 	benchmarkOp<uint16_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint16_t /*a*/, uint16_t b) {
 		return b;
-	}, "0 * u16 + u16", cpuInfo, output);
+	}, "0 * u16 + u16", report);
 	ipc::writeU32Data(srcBuffer, BufferSize);
 	benchmarkOp<uint32_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint32_t /*a*/, uint32_t b) {
 		return b;
-	}, "0 * u32 + u32", cpuInfo, output);
+	}, "0 * u32 + u32", report);
 	ipc::writeU64Data(srcBuffer, BufferSize);
 	benchmarkOp<uint64_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint64_t /*a*/, uint64_t b) {
 		return b;
-	}, "0 * u64 + u64", cpuInfo, output);
+	}, "0 * u64 + u64", report);
 
 	ipc::writeU16Data(srcBuffer, BufferSize);
 	benchmarkOp<uint16_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint16_t a, uint16_t b) {
 		return a + b;
-	}, "u16 + u16", cpuInfo, output);
+	}, "u16 + u16", report);
 	ipc::writeU32Data(srcBuffer, BufferSize);
 	benchmarkOp<uint32_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint32_t a, uint32_t b) {
 		return a + b;
-	}, "u32 + u32", cpuInfo, output);
+	}, "u32 + u32", report);
 	ipc::writeU64Data(srcBuffer, BufferSize);
 	benchmarkOp<uint64_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint64_t a, uint64_t b) {
 		return a + b;
-	}, "u64 + u64", cpuInfo, output);
+	}, "u64 + u64", report);
 
 	ipc::writeU16Data(srcBuffer, BufferSize);
 	benchmarkOp<uint16_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint16_t a, uint16_t b) {
 		return a - b;
-	}, "u16 - u16", cpuInfo, output);
+	}, "u16 - u16", report);
 	ipc::writeU32Data(srcBuffer, BufferSize);
 	benchmarkOp<uint32_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint32_t a, uint32_t b) {
 		return a - b;
-	}, "u32 - u32", cpuInfo, output);
+	}, "u32 - u32", report);
 	ipc::writeU64Data(srcBuffer, BufferSize);
 	benchmarkOp<uint64_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint64_t a, uint64_t b) {
 		return a - b;
-	}, "u64 - u64", cpuInfo, output);
+	}, "u64 - u64", report);
 
 	/*ipc::writeU16Data(srcBuffer, BufferSize);
 	benchmarkOp<uint16_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint16_t a, uint16_t b) {
 		return a / b;
-	}, "u16 / u16", cpuInfo, output);*/
+	}, "u16 / u16", report);*/
 	ipc::writeU32Data(srcBuffer, BufferSize);
 	ipc::convU32ToF32(srcBuffer, BufferSize);
 	benchmarkOp<float, BufferSize>(durationMeasurer, srcBuffer, buffer, [](float a, float b) {
 		return a / b;
-	}, "f32 / f32", cpuInfo, output);
+	}, "f32 / f32", report);
 	ipc::writeU64Data(srcBuffer, BufferSize);
 	ipc::convU64ToF64(srcBuffer, BufferSize);
 	benchmarkOp<double, BufferSize>(durationMeasurer, srcBuffer, buffer, [](double a, double b) {
 		return a / b;
-	}, "f64 / f64", cpuInfo, output);
+	}, "f64 / f64", report);
 
 	ipc::writeU16Data(srcBuffer, BufferSize);
 	benchmarkOp<uint16_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint16_t a, uint16_t b) {
 		return a * b;
-	}, "u16 * u16", cpuInfo, output);
+	}, "u16 * u16", report);
 	ipc::writeU32Data(srcBuffer, BufferSize);
 	benchmarkOp<uint32_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint32_t a, uint32_t b) {
 		return a * b;
-	}, "u32 * u32", cpuInfo, output);
+	}, "u32 * u32", report);
 	ipc::writeU64Data(srcBuffer, BufferSize);
 	benchmarkOp<uint64_t, BufferSize>(durationMeasurer, srcBuffer, buffer, [](uint64_t a, uint64_t b) {
 		return a * b;
-	}, "u64 * u64", cpuInfo, output);
+	}, "u64 * u64", report);
 	std::printf("\n");
 }
 
-int main(void) {
+static void benchmarkOps(const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
+	//benchmark<1 << 6>(durationMeasurer, report);
+	benchmark<1 << 7>(durationMeasurer, report);
+	benchmark<1 << 8>(durationMeasurer, report);
+	benchmark<1 << 9>(durationMeasurer, report);
+	benchmark<1 << 10>(durationMeasurer, report);
+	//benchmark<1 << 11>(durationMeasurer, report);
+	benchmark<1 << 12>(durationMeasurer, report);
+	//benchmark<1 << 14>(durationMeasurer, report);
+	benchmark<1 << 16>(durationMeasurer, report);
+}
+
+static inline constexpr auto usage =
+	"Usage: ipc-benchmark [mode] [options] [--trace[=<samples>]]\n"
+	"  --trace         Also write samples to report.trace.csv, which lets compare test rows for significance (before the mode or among its options)\n"
+	"                  At most 1024 per row, evenly spread, or <samples> with --trace=<samples>\n"
+	"Modes:\n"
+	"  ops (default)   Cycles per arithmetic operation, pipelined and sequentially\n"
+	"  prefetch        Hardware prefetcher coverage over stride, direction, streams and page order\n"
+	"    --toggle-prefetchers   Also run every pattern with the prefetchers disabled through MSRs (WinRing0 on Windows, msr module as root or CAP_SYS_RAWIO on Linux)\n"
+	"  branch          Cycles per branch over generated patterns, misprediction penalty and predictor history capacity\n"
+	"  dispatch        Cycles per call: inlined, direct, function pointer, virtual, std::function and deep call chains\n"
+	"  frontend        Cycles per instruction and IPC of generated code over its footprint: uop cache, L1i, L2 and iTLB cliffs\n"
+	"    --max-size <bytes>          Largest code footprint (default 33554432)\n"
+	"  roofline        Compute ceilings per ISA level, read bandwidth per cache level and DRAM, roofline dataset\n"
+	"    --kernel <name>=<op/byte>   Place a kernel on the roofline by arithmetic intensity, repeatable\n"
+	"    --output <path>             Roofline dataset path (default ./roofline.csv)\n"
+	"  kernel          Cycles per kernel crossing: null syscall, vDSO clock_gettime, futex, pipe, eventfd and Unix socket round trips, shared memory spin (Linux only)\n"
+	"    --cores <a>,<b>             Cores the two sides of round trips are pinned to (default: the first two allowed)\n"
+	"  alloc           Cycles per malloc/free and new/delete pair over size classes, free orders and thread counts, tail latency and RSS growth\n"
+	"    --max-threads <count>       Largest thread count (default: every logical processor, at most 16)\n"
+	"  fault           Cycles per 4 KiB page: first touch (4 KiB, THP, hugetlbfs), MAP_POPULATE, MADV_DONTNEED, mremap, page cache reads (Linux only)\n"
+	"    --max-threads <count>       Largest thread count (default: every logical processor, at most 16)\n"
+	"    --directory <path>          Where temporary files of file-backed cases go, better disk-backed than tmpfs (default: the working directory)\n"
+	"  probe           Daemon: ALU, last level cache and DRAM latency and DRAM bandwidth probes at a bounded duty cycle, Prometheus metrics with rolling baselines\n"
+	"    --core <index>              Pin the probes to this logical processor\n"
+	"    --duty-cycle <percent>      Upper bound on the share of wall time spent probing (default 0.5)\n"
+	"    --interval <seconds>        Minimum time between the start of two rounds (default 60)\n"
+	"    --window <rounds>           Rounds the rolling baseline is the median of (default 60)\n"
+	"    --rounds <count>            Stop after this many rounds (default 0, run forever)\n"
+	"    --textfile <path>           Prometheus textfile, empty disables it (default ./ipc-benchmark.prom)\n"
+	"    --socket <path>             Also serve the metrics on a Unix socket\n"
+	"  compare [options] <baseline.csv> <candidate.csv>...\n"
+	"                  Regressions and improvements of each candidate report against the baseline, exits with 1 on any regression\n"
+	"    --threshold <percent>       Relative change under which a row is unchanged (default 5)\n"
+	"    --alpha <level>             Significance level of Welch's t-test, for rows traced on both sides (default 0.01)\n"
+	"    --output <path>             Also write every matched row with its verdict\n";
+
+[[noreturn]] static void throwUsage(const std::string &reason) {
+	std::stringstream ss;
+	ss << reason << "\n" << usage;
+	throw std::runtime_error(ss.str());
+}
+
+using ModeRunner = std::function<void (const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report)>;
+
+// Offline mode: works on existing reports, no measurement
+static ipc::CompareOptions parseCompare(const std::vector<std::string> &options) {
+	ipc::CompareOptions compareOptions;
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < options.size(); i++) {
+		auto &option = options[i];
+		if (!option.starts_with("--")) {
+			paths.emplace_back(option);
+			continue;
+		}
+		if (i + 1 >= options.size())
+			throwUsage("Missing value for option '" + option + "'");
+		auto &value = options[++i];
+		if (option == "--threshold")
+			compareOptions.thresholdPercent = std::stod(value);
+		else if (option == "--alpha")
+			compareOptions.alpha = std::stod(value);
+		else if (option == "--output")
+			compareOptions.outputPath = value;
+		else
+			throwUsage("Unknown option '" + option + "' for mode 'compare'");
+	}
+	if (paths.size() < 2)
+		throwUsage("Mode 'compare' expects a baseline report and at least one candidate report");
+	compareOptions.baselinePath = paths[0];
+	compareOptions.candidatePaths.assign(paths.begin() + 1, paths.end());
+	return compareOptions;
+}
+
+// --trace[=<samples>] is taken wherever an option may start, never as the value of another option
+static bool takeTrace(const std::string &option, bool &trace, size_t &traceSampleLimit) {
+	constexpr std::string_view limitPrefix = "--trace=";
+	if (option.starts_with(limitPrefix)) {
+		auto value = option.substr(limitPrefix.size());
+		auto reason = "Expected a positive sample count for '--trace=', got '" + value + "'";
+		// std::stoull would take signs and trailing garbage
+		if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+			throwUsage(reason);
+		try {
+			traceSampleLimit = std::stoull(value);
+		} catch (const std::out_of_range&) {
+			throwUsage(reason);
+		}
+		if (traceSampleLimit == 0)
+			throwUsage(reason);
+	} else if (option != "--trace")
+		return false;
+	trace = true;
+	return true;
+}
+
+// Resolves the command line before anything slow (calibration) happens
+// trace: set when --trace is given before the mode or among its options, traceSampleLimit is its optional value
+// realtime: cleared for modes that must stay out of the way of the host's workload
+static ModeRunner parseMode(std::vector<std::string> args, bool &trace, size_t &traceSampleLimit, bool &realtime) {
+	while (!args.empty() && takeTrace(args[0], trace, traceSampleLimit))
+		args.erase(args.begin());
+	auto mode = args.empty() ? std::string("ops") : args[0];
+	auto options = args.empty() ? std::vector<std::string>() : std::vector<std::string>(args.begin() + 1, args.end());
+
+	if (mode == "ops") {
+		for (auto &option : options) {
+			if (!takeTrace(option, trace, traceSampleLimit))
+				throwUsage("Unknown option '" + option + "' for mode 'ops'");
+		}
+		return benchmarkOps;
+	} else if (mode == "prefetch") {
+		ipc::PrefetchOptions prefetchOptions;
+		for (auto &option : options) {
+			if (takeTrace(option, trace, traceSampleLimit))
+				continue;
+			if (option == "--toggle-prefetchers")
+				prefetchOptions.togglePrefetchers = true;
+			else
+				throwUsage("Unknown option '" + option + "' for mode 'prefetch'");
+		}
+		return [prefetchOptions](const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
+			ipc::benchmarkPrefetch(durationMeasurer, report, prefetchOptions);
+		};
+	} else if (mode == "branch") {
+		for (auto &option : options) {
+			if (!takeTrace(option, trace, traceSampleLimit))
+				throwUsage("Unknown option '" + option + "' for mode 'branch'");
+		}
+		return ipc::benchmarkBranch;
+	} else if (mode == "dispatch") {
+		for (auto &option : options) {
+			if (!takeTrace(option, trace, traceSampleLimit))
+				throwUsage("Unknown option '" + option + "' for mode 'dispatch'");
+		}
+		return ipc::benchmarkDispatch;
+	} else if (mode == "frontend") {
+		ipc::FrontendOptions frontendOptions;
+		for (size_t i = 0; i < options.size(); i++) {
+			auto &option = options[i];
+			if (takeTrace(option, trace, traceSampleLimit))
+				continue;
+			if (i + 1 >= options.size())
+				throwUsage("Missing value for option '" + option + "'");
+			auto &value = options[++i];
+			if (option == "--max-size")
+				frontendOptions.maxSize = std::stoull(value);
+			else
+				throwUsage("Unknown option '" + option + "' for mode 'frontend'");
+		}
+		return [frontendOptions](const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
+			ipc::benchmarkFrontend(durationMeasurer, report, frontendOptions);
+		};
+	} else if (mode == "roofline") {
+		ipc::RooflineOptions rooflineOptions;
+		for (size_t i = 0; i < options.size(); i++) {
+			auto &option = options[i];
+			if (takeTrace(option, trace, traceSampleLimit))
+				continue;
+			if (i + 1 >= options.size())
+				throwUsage("Missing value for option '" + option + "'");
+			auto &value = options[++i];
+			if (option == "--kernel") {
+				auto sep = value.find('=');
+				if (sep == std::string::npos || sep == 0)
+					throwUsage("Expected <name>=<op/byte> for --kernel, got '" + value + "'");
+				rooflineOptions.kernels.emplace_back(ipc::RooflineKernel{
+					.name = value.substr(0, sep),
+					.intensity = std::stod(value.substr(sep + 1))
+				});
+			} else if (option == "--output")
+				rooflineOptions.outputPath = value;
+			else
+				throwUsage("Unknown option '" + option + "' for mode 'roofline'");
+		}
+		return [rooflineOptions](const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
+			ipc::benchmarkRoofline(durationMeasurer, report, rooflineOptions);
+		};
+	} else if (mode == "kernel") {
+		ipc::KernelOptions kernelOptions;
+		for (size_t i = 0; i < options.size(); i++) {
+			auto &option = options[i];
+			if (takeTrace(option, trace, traceSampleLimit))
+				continue;
+			if (i + 1 >= options.size())
+				throwUsage("Missing value for option '" + option + "'");
+			auto &value = options[++i];
+			if (option == "--cores") {
+				auto sep = value.find(',');
+				if (sep == std::string::npos || sep == 0)
+					throwUsage("Expected <a>,<b> for --cores, got '" + value + "'");
+				kernelOptions.cores = std::make_pair(std::stoull(value.substr(0, sep)), std::stoull(value.substr(sep + 1)));
+			} else
+				throwUsage("Unknown option '" + option + "' for mode 'kernel'");
+		}
+		return [kernelOptions](const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
+			ipc::benchmarkKernel(durationMeasurer, report, kernelOptions);
+		};
+	} else if (mode == "alloc") {
+		ipc::AllocOptions allocOptions;
+		for (size_t i = 0; i < options.size(); i++) {
+			auto &option = options[i];
+			if (takeTrace(option, trace, traceSampleLimit))
+				continue;
+			if (i + 1 >= options.size())
+				throwUsage("Missing value for option '" + option + "'");
+			auto &value = options[++i];
+			if (option == "--max-threads")
+				allocOptions.maxThreadCount = std::stoull(value);
+			else
+				throwUsage("Unknown option '" + option + "' for mode 'alloc'");
+		}
+		return [allocOptions](const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
+			ipc::benchmarkAlloc(durationMeasurer, report, allocOptions);
+		};
+	} else if (mode == "fault") {
+		ipc::FaultOptions faultOptions;
+		for (size_t i = 0; i < options.size(); i++) {
+			auto &option = options[i];
+			if (takeTrace(option, trace, traceSampleLimit))
+				continue;
+			if (i + 1 >= options.size())
+				throwUsage("Missing value for option '" + option + "'");
+			auto &value = options[++i];
+			if (option == "--max-threads")
+				faultOptions.maxThreadCount = std::stoull(value);
+			else if (option == "--directory")
+				faultOptions.directory = value;
+			else
+				throwUsage("Unknown option '" + option + "' for mode 'fault'");
+		}
+		return [faultOptions](const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
+			ipc::benchmarkFault(durationMeasurer, report, faultOptions);
+		};
+	} else if (mode == "probe") {
+		// Long-lived daemon on production hosts: realtime priority for its whole lifetime would starve the workload it watches
+		realtime = false;
+		ipc::ProbeOptions probeOptions;
+		for (size_t i = 0; i < options.size(); i++) {
+			auto &option = options[i];
+			if (takeTrace(option, trace, traceSampleLimit))
+				continue;
+			if (i + 1 >= options.size())
+				throwUsage("Missing value for option '" + option + "'");
+			auto &value = options[++i];
+			if (option == "--core")
+				probeOptions.core = std::stoull(value);
+			else if (option == "--duty-cycle")
+				probeOptions.dutyCyclePercent = std::stod(value);
+			else if (option == "--interval")
+				probeOptions.intervalSeconds = std::stod(value);
+			else if (option == "--window")
+				probeOptions.baselineWindow = std::stoull(value);
+			else if (option == "--rounds")
+				probeOptions.roundCount = std::stoull(value);
+			else if (option == "--textfile")
+				probeOptions.textfilePath = value;
+			else if (option == "--socket")
+				probeOptions.socketPath = value;
+			else
+				throwUsage("Unknown option '" + option + "' for mode 'probe'");
+		}
+		return [probeOptions](const ipc::DurationMeasurer &durationMeasurer, const ipc::Report &report) {
+			ipc::runProbes(durationMeasurer, report, probeOptions);
+		};
+	} else
+		throwUsage("Unknown mode '" + mode + "'");
+}
+
+int main(int argc, char **argv) {
 	try {
-		auto cpuInfo = ipc::getCPUInfo();
-		auto cpuInfoCStr = cpuInfo.c_str();
+		auto args = std::vector<std::string>(argv + 1, argv + argc);
+		if (!args.empty() && args[0] == "compare")
+			return ipc::compareReports(parseCompare(std::vector<std::string>(args.begin() + 1, args.end())));
 
-		// Necessary to accurately estimate CPUs frequency from cycle count and std::chrono
-		ipc::setRealtime();
+		bool trace = false;
+		auto traceSampleLimit = ipc::Report::defaultTraceSampleLimit;
+		bool realtime = true;
+		auto runMode = parseMode(args, trace, traceSampleLimit, realtime);
 
-		auto measurer = ipc::DurationMeasurer();
-		measurer.calibrate();
+		auto session = ipc::Session(meta, "./report.csv", realtime, trace, traceSampleLimit);
+		auto &measurer = session.getDurationMeasurer();
 		{
 			auto overhead = measurer.getOverhead();
 			std::printf("Overhead: %g cycles, %g ns\n", overhead.lengthCycles, overhead.lengthSeconds * 1.0e9);
-			std::printf("CPU identified as '%s'\n", cpuInfoCStr);
+			std::printf("CPU identified as '%s'\n", session.getCPUInfo().c_str());
 		}
 
 		std::printf("\n");
@@ -126,18 +423,7 @@ int main(void) {
 
 		std::printf("\n");
 
-		std::ofstream output("./report.csv", std::ios::out);
-		output << "Meta, CPU model, Operation, Execution, Buffer size [byte], Cycle count, Frequency [MHz]" << std::endl;
-
-		//benchmark<1 << 6>(measurer, cpuInfoCStr, output);
-		benchmark<1 << 7>(measurer, cpuInfoCStr, output);
-		benchmark<1 << 8>(measurer, cpuInfoCStr, output);
-		benchmark<1 << 9>(measurer, cpuInfoCStr, output);
-		benchmark<1 << 10>(measurer, cpuInfoCStr, output);
-		//benchmark<1 << 11>(measurer, cpuInfoCStr, output);
-		benchmark<1 << 12>(measurer, cpuInfoCStr, output);
-		//benchmark<1 << 14>(measurer, cpuInfoCStr, output);
-		benchmark<1 << 16>(measurer, cpuInfoCStr, output);
+		runMode(measurer, session.getReport());
 	} catch (const std::exception &e) {
 		std::fprintf(stderr, "FATAL ERROR: %s\n", e.what());
 
@@ -149,6 +435,7 @@ int main(void) {
 			std::getchar();
 		}
 		#endif
+		return 2;
 	}
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "peak_kernel.hpp"
+
+namespace ipc {
+
+double peakMaddF64Scalar(double m, double c, size_t iterationCount) {
+	return peakMadd<double, double, peakSplitAccumulatorCount>(m, c, iterationCount);
+}
+
+float peakMaddF32Scalar(float m, float c, size_t iterationCount) {
+	return peakMadd<float, float, peakSplitAccumulatorCount>(m, c, iterationCount);
+}
+
+double peakMaddF64Sse2(double m, double c, size_t iterationCount) {
+	return peakMadd<PeakF64x2, double, peakSplitAccumulatorCount>(m, c, iterationCount);
+}
+
+float peakMaddF32Sse2(float m, float c, size_t iterationCount) {
+	return peakMadd<PeakF32x4, float, peakSplitAccumulatorCount>(m, c, iterationCount);
+}
+
+uint64_t peakReadScalar(const void *data, size_t size, size_t repeatCount) {
+	return peakRead<uint64_t>(data, size, repeatCount);
+}
+
+uint64_t peakReadSse2(const void *data, size_t size, size_t repeatCount) {
+	return peakRead<PeakU64x2>(data, size, repeatCount);
+}
+
+PeakReadKernel getWidestPeakRead(void) {
+	if (__builtin_cpu_supports("avx512f"))
+		return peakReadAvx512;
+	if (__builtin_cpu_supports("avx2"))
+		return peakReadAvx2;
+	return peakReadSse2;
+}
+
+}
\ No newline at end of file
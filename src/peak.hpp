@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ipc {
+
+// Register-resident multiply-add throughput kernels and streaming read kernels, one translation unit per ISA level
+// peak.cpp is baseline x86-64 (scalar and SSE2, separate multiply and add), peak_avx2.cpp is built with AVX2 and FMA, peak_avx512.cpp with AVX-512F
+// The AVX ones must only be called once the host is known to support them
+// Every kernel returns a reduction of its accumulators so that nothing gets optimized away
+
+// Multiply-add chains in flight have to cover their latency times the ports running them
+// Fused FMA: 4 cycles x 2 ports on current cores, 12 chains leave room
+inline constexpr size_t peakFmaAccumulatorCount = 12;
+// Separate multiply then add (scalar and SSE2): 8 cycles x 1 madd per cycle on Intel (both on ports 0 and 1), 6 cycles x 2 on Zen
+// 14 chains and the two constants fill the 16 XMM registers, more would spill and chain through store forwarding
+inline constexpr size_t peakSplitAccumulatorCount = 14;
+// Reads go through 8 independent accumulators of the widest vector: sizes must be a multiple of this
+inline constexpr size_t peakReadGranularity = 1 << 9;
+
+double peakMaddF64Scalar(double m, double c, size_t iterationCount);
+float peakMaddF32Scalar(float m, float c, size_t iterationCount);
+double peakMaddF64Sse2(double m, double c, size_t iterationCount);
+float peakMaddF32Sse2(float m, float c, size_t iterationCount);
+double peakMaddF64Avx2(double m, double c, size_t iterationCount);
+float peakMaddF32Avx2(float m, float c, size_t iterationCount);
+double peakMaddF64Avx512(double m, double c, size_t iterationCount);
+float peakMaddF32Avx512(float m, float c, size_t iterationCount);
+
+uint64_t peakReadScalar(const void *data, size_t size, size_t repeatCount);
+uint64_t peakReadSse2(const void *data, size_t size, size_t repeatCount);
+uint64_t peakReadAvx2(const void *data, size_t size, size_t repeatCount);
+uint64_t peakReadAvx512(const void *data, size_t size, size_t repeatCount);
+
+using PeakReadKernel = uint64_t (*)(const void *data, size_t size, size_t repeatCount);
+
+// Widest read kernel the host supports
+PeakReadKernel getWidestPeakRead(void);
+
+}
\ No newline at end of file
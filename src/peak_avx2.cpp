@@ -0,0 +1,19 @@
+#include "peak_kernel.hpp"
+
+// Built with -mavx2 -mfma -ffp-contract=fast: multiply-adds become FMAs
+
+namespace ipc {
+
+double peakMaddF64Avx2(double m, double c, size_t iterationCount) {
+	return peakMadd<PeakF64x4, double, peakFmaAccumulatorCount>(m, c, iterationCount);
+}
+
+float peakMaddF32Avx2(float m, float c, size_t iterationCount) {
+	return peakMadd<PeakF32x8, float, peakFmaAccumulatorCount>(m, c, iterationCount);
+}
+
+uint64_t peakReadAvx2(const void *data, size_t size, size_t repeatCount) {
+	return peakRead<PeakU64x4>(data, size, repeatCount);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#include "peak_kernel.hpp"
+
+// Built with -mavx512f -ffp-contract=fast: multiply-adds become FMAs
+
+namespace ipc {
+
+double peakMaddF64Avx512(double m, double c, size_t iterationCount) {
+	return peakMadd<PeakF64x8, double, peakFmaAccumulatorCount>(m, c, iterationCount);
+}
+
+float peakMaddF32Avx512(float m, float c, size_t iterationCount) {
+	return peakMadd<PeakF32x16, float, peakFmaAccumulatorCount>(m, c, iterationCount);
+}
+
+uint64_t peakReadAvx512(const void *data, size_t size, size_t repeatCount) {
+	return peakRead<PeakU64x8>(data, size, repeatCount);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+// Only to be included by the peak*.cpp translation units
+// Everything here has internal linkage: instantiations must not leak out of a translation unit built for a given ISA
+
+#include <cstring>
+#include "peak.hpp"
+
+namespace ipc {
+
+// GCC vector extensions: code generation follows the ISA flags of the including translation unit
+typedef double PeakF64x2 __attribute__((vector_size(16)));
+typedef double PeakF64x4 __attribute__((vector_size(32)));
+typedef double PeakF64x8 __attribute__((vector_size(64)));
+typedef float PeakF32x4 __attribute__((vector_size(16)));
+typedef float PeakF32x8 __attribute__((vector_size(32)));
+typedef float PeakF32x16 __attribute__((vector_size(64)));
+typedef uint64_t PeakU64x2 __attribute__((vector_size(16)));
+typedef uint64_t PeakU64x4 __attribute__((vector_size(32)));
+typedef uint64_t PeakU64x8 __attribute__((vector_size(64)));
+
+template <typename V, typename T>
+static inline T reducePeakVector(const V &v) {
+	constexpr size_t laneCount = sizeof(V) / sizeof(T);
+	T lanes[laneCount];
+	std::memcpy(lanes, &v, sizeof(V));
+	T res = 0;
+	for (size_t l = 0; l < laneCount; l++)
+		res += lanes[l];
+	return res;
+}
+
+// AccumulatorCount independent chains of acc = acc * m + c, see peakFmaAccumulatorCount and peakSplitAccumulatorCount
+// Keep |m| < 1 so that accumulators converge instead of overflowing
+template <typename V, typename T, size_t AccumulatorCount>
+static inline T peakMadd(T m, T c, size_t iterationCount) {
+	V vm = V{} + m;
+	V vc = V{} + c;
+	V acc[AccumulatorCount];
+	for (size_t k = 0; k < AccumulatorCount; k++)
+		acc[k] = vc * static_cast<T>(k + 1);
+
+	for (size_t i = 0; i < iterationCount; i++) {
+		for (size_t k = 0; k < AccumulatorCount; k++)
+			acc[k] = acc[k] * vm + vc;
+	}
+
+	for (size_t k = 1; k < AccumulatorCount; k++)
+		acc[0] += acc[k];
+	return reducePeakVector<V, T>(acc[0]);
+}
+
+template <typename V>
+static inline uint64_t peakRead(const void *data, size_t size, size_t repeatCount) {
+	constexpr size_t accumulatorCount = 8;
+	static_assert(peakReadGranularity % (sizeof(V) * accumulatorCount) == 0, "peakReadGranularity must cover every accumulator");
+
+	auto words = reinterpret_cast<const V*>(data);
+	auto count = size / sizeof(V);
+	V acc[accumulatorCount] = {};
+	for (size_t r = 0; r < repeatCount; r++) {
+		for (size_t i = 0; i < count; i += accumulatorCount) {
+			for (size_t k = 0; k < accumulatorCount; k++)
+				acc[k] += words[i + k];
+		}
+	}
+
+	for (size_t k = 1; k < accumulatorCount; k++)
+		acc[0] += acc[k];
+	return reducePeakVector<V, uint64_t>(acc[0]);
+}
+
+}
\ No newline at end of file
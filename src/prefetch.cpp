@@ -0,0 +1,247 @@
+#include "prefetch.hpp"
+
+#include <vector>
+#include <numeric>
+#include <random>
+#include <algorithm>
+#include <optional>
+
+namespace ipc {
+
+static inline constexpr size_t prefetchLineSize = 64;
+static inline constexpr size_t prefetchPageSize = 1 << 12;
+// 256 MiB: way past any last level cache, so that nothing but the prefetchers can hide DRAM latency
+static inline constexpr size_t prefetchBufferSize = static_cast<size_t>(1) << 28;
+static inline constexpr size_t prefetchMaxAccessCount = 1 << 18;
+static inline constexpr size_t prefetchIterationCount = 1 << 4;
+
+enum class PrefetchDirection {
+	Forward,
+	Backward
+};
+
+enum class PrefetchPageOrder {
+	// Streams walk through contiguous pages, page boundaries are crossed as-is
+	Sequential,
+	// Each page is visited in stride order, but pages themselves are visited in a random order
+	Shuffled
+};
+
+struct PrefetchPattern {
+	size_t stride;
+	PrefetchDirection direction;
+	size_t streamCount;
+	PrefetchPageOrder pageOrder;
+
+	std::string toString(void) const {
+		std::stringstream ss;
+		ss << "Load stride " << stride << " B " << (direction == PrefetchDirection::Forward ? "forward" : "backward")
+			<< " " << streamCount << " stream(s) " << (pageOrder == PrefetchPageOrder::Sequential ? "sequential" : "shuffled") << " pages";
+		return ss.str();
+	}
+};
+
+// Cache line indices in the order they are accessed
+// Streams are interleaved: stream s owns the s-th slice of the buffer and all streams advance in lockstep
+static std::vector<uint32_t> generatePrefetchOrder(const PrefetchPattern &pattern) {
+	auto regionSize = prefetchBufferSize / pattern.streamCount;
+	auto regionPageCount = regionSize / prefetchPageSize;
+	auto perStreamCount = std::min(regionSize / pattern.stride, prefetchMaxAccessCount / pattern.streamCount);
+
+	std::vector<size_t> pageMap(regionPageCount);
+	std::iota(pageMap.begin(), pageMap.end(), 0);
+	if (pattern.pageOrder == PrefetchPageOrder::Shuffled) {
+		std::mt19937_64 rng(0x1A4);
+		std::shuffle(pageMap.begin(), pageMap.end(), rng);
+	}
+
+	std::vector<uint32_t> res;
+	res.reserve(perStreamCount * pattern.streamCount);
+	for (size_t i = 0; i < perStreamCount; i++) {
+		auto step = pattern.direction == PrefetchDirection::Forward ? i : perStreamCount - 1 - i;
+		auto offset = step * pattern.stride;
+		auto page = offset / prefetchPageSize;
+		auto inPage = offset % prefetchPageSize;
+		for (size_t s = 0; s < pattern.streamCount; s++) {
+			auto byte = s * regionSize + pageMap[page] * prefetchPageSize + inPage;
+			res.emplace_back(static_cast<uint32_t>(byte / prefetchLineSize));
+		}
+	}
+	return res;
+}
+
+static inline void flushPrefetchLines(Buffer &buffer, const std::vector<uint32_t> &order) {
+	auto bytes = reinterpret_cast<const char*>(buffer.data);
+	for (auto line : order)
+		_mm_clflush(bytes + static_cast<size_t>(line) * prefetchLineSize);
+	_mm_mfence();
+}
+
+// Every accessed line holds the word index of the next line to access, so that each load depends on the previous one
+static Statistics measurePrefetchLatency(const DurationMeasurer &durationMeasurer, Buffer &buffer, const std::vector<uint32_t> &order) {
+	constexpr size_t wordsPerLine = prefetchLineSize / sizeof(size_t);
+	auto words = reinterpret_cast<size_t*>(buffer.data);
+	for (size_t i = 0; i < order.size(); i++)
+		words[static_cast<size_t>(order[i]) * wordsPerLine] = static_cast<size_t>(order[(i + 1) % order.size()]) * wordsPerLine;
+
+	volatile size_t sink = 0;
+	auto sample = [&]() {
+		flushPrefetchLines(buffer, order);
+
+		return durationMeasurer.measure([&]() {
+			const size_t * const chain = words;
+			auto count = order.size();
+			size_t cur = static_cast<size_t>(order[0]) * wordsPerLine;
+			for (size_t i = 0; i < count; i++)
+				cur = chain[cur];
+			sink = cur;
+		});
+	};
+
+	// No warmup: lines are flushed before every sample anyway
+	return sampleDurations(prefetchIterationCount, sample, false) / order.size();
+}
+
+// Loads are independent from each other, the amount of them in flight is only bounded by the core and the prefetchers
+// The line indices are themselves streamed from memory, which amounts to 4 extra bytes per 64-byte line
+static Statistics measurePrefetchBandwidth(const DurationMeasurer &durationMeasurer, Buffer &buffer, const std::vector<uint32_t> &order) {
+	constexpr size_t wordsPerLine = prefetchLineSize / sizeof(size_t);
+	auto words = reinterpret_cast<const size_t*>(buffer.data);
+
+	volatile size_t sink = 0;
+	auto sample = [&]() {
+		flushPrefetchLines(buffer, order);
+
+		return durationMeasurer.measure([&]() {
+			auto lines = order.data();
+			auto count = order.size();
+			size_t acc = 0;
+			for (size_t i = 0; i < count; i++)
+				acc += words[static_cast<size_t>(lines[i]) * wordsPerLine];
+			sink = acc;
+		});
+	};
+
+	// No warmup: lines are flushed before every sample anyway
+	return sampleDurations(prefetchIterationCount, sample, false) / order.size();
+}
+
+// Disables the hardware prefetchers on every logical processor for its lifetime, restores the original MSR values on destruction
+// Intel: MISC_FEATURE_CONTROL (0x1A4), bits 0-3 disable L2 streamer, L2 adjacent line, L1 next line and L1 IP stride
+// AMD (family 19h onwards, Zen 3 and later): PrefetchControl (0xC0000108), bits 0-3 and 5 disable L1 stream, L1 stride, L1 region, L2 stream and L2 up/down
+// Zen 1 and 2 do not document that MSR, writing it may fault
+// Every logical processor this process may run on is covered, every write is read back
+class PrefetcherDisabler
+{
+	uint32_t m_index;
+	std::vector<size_t> m_cores;
+	std::vector<uint64_t> m_original;
+
+public:
+	PrefetcherDisabler(void) {
+		auto signature = getCPUSignature();
+		uint64_t disableMask;
+		if (signature.vendor == "GenuineIntel") {
+			m_index = 0x1A4;
+			disableMask = 0x0F;
+		} else if (signature.vendor == "AuthenticAMD" && signature.family >= 0x19) {
+			m_index = 0xC0000108;
+			disableMask = 0x2F;
+		} else {
+			std::stringstream ss;
+			ss << "ipc::PrefetcherDisabler: No known prefetcher control for vendor '" << signature.vendor << "', family 0x" << std::hex << signature.family;
+			throw std::runtime_error(ss.str());
+		}
+
+		m_cores = getMSRCores();
+		for (auto core : m_cores)
+			m_original.emplace_back(readMSROnCore(m_index, core));
+		try {
+			for (size_t i = 0; i < m_cores.size(); i++) {
+				writeMSROnCore(m_index, m_cores[i], m_original[i] | disableMask);
+				// Some hosts (hypervisors, firmware locks) take the write without applying it
+				if ((readMSROnCore(m_index, m_cores[i]) & disableMask) != disableMask) {
+					std::stringstream ss;
+					ss << "ipc::PrefetcherDisabler: MSR 0x" << std::hex << m_index << " on core " << std::dec << m_cores[i] << " did not keep the disable bits";
+					throw std::runtime_error(ss.str());
+				}
+			}
+		} catch (const std::exception&) {
+			restore();
+			throw;
+		}
+	}
+
+	PrefetcherDisabler(const PrefetcherDisabler &other) = delete;
+	PrefetcherDisabler& operator=(const PrefetcherDisabler &other) = delete;
+
+private:
+	void restore(void) noexcept {
+		for (size_t i = 0; i < m_original.size(); i++) {
+			try {
+				writeMSROnCore(m_index, m_cores[i], m_original[i]);
+			} catch (const std::exception &e) {
+				std::fprintf(stderr, "ipc::PrefetcherDisabler: Could not restore prefetchers: %s\n", e.what());
+			}
+		}
+	}
+
+public:
+	~PrefetcherDisabler(void) {
+		restore();
+	}
+};
+
+static void benchmarkPrefetchPatterns(const DurationMeasurer &durationMeasurer, const Report &report, Buffer &buffer, const char *executionSuffix) {
+	static constexpr size_t strides[] = {1 << 6, 1 << 7, 1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14};
+	static constexpr size_t streamCounts[] = {1, 2, 4, 8, 16};
+
+	for (auto pageOrder : {PrefetchPageOrder::Sequential, PrefetchPageOrder::Shuffled}) {
+		for (auto streamCount : streamCounts) {
+			for (auto direction : {PrefetchDirection::Forward, PrefetchDirection::Backward}) {
+				for (auto stride : strides) {
+					auto pattern = PrefetchPattern{
+						.stride = stride,
+						.direction = direction,
+						.streamCount = streamCount,
+						.pageOrder = pageOrder
+					};
+					auto order = generatePrefetchOrder(pattern);
+					auto opStr = pattern.toString();
+
+					auto latency = measurePrefetchLatency(durationMeasurer, buffer, order);
+					std::printf("%s%s latency: avg = %g cycles per line, %g ns (%g MHz)\n", opStr.c_str(), executionSuffix, latency.mean.lengthCycles, latency.mean.lengthSeconds * 1.0e9, latency.mean.inferredFrequencyMHz());
+					report.writeRow(opStr, std::string("Latency") + executionSuffix, buffer.size, latency);
+
+					auto bandwidth = measurePrefetchBandwidth(durationMeasurer, buffer, order);
+					std::printf("%s%s bandwidth: avg = %g cycles per line, %g bytes per cycle, %g GB/s (%g MHz)\n", opStr.c_str(), executionSuffix, bandwidth.mean.lengthCycles,
+						static_cast<double>(prefetchLineSize) / bandwidth.mean.lengthCycles, static_cast<double>(prefetchLineSize) / bandwidth.mean.lengthSeconds / 1.0e9, bandwidth.mean.inferredFrequencyMHz());
+					report.writeRow(opStr, std::string("Bandwidth") + executionSuffix, buffer.size, bandwidth);
+				}
+			}
+		}
+		std::printf("\n");
+	}
+}
+
+void benchmarkPrefetch(const DurationMeasurer &durationMeasurer, const Report &report, const PrefetchOptions &options) {
+	auto buffer = Buffer(prefetchBufferSize);
+	// Fault every page in beforehand, page faults are not what is measured here
+	std::memset(buffer.data, 0, buffer.size);
+
+	benchmarkPrefetchPatterns(durationMeasurer, report, buffer, "");
+
+	if (options.togglePrefetchers) {
+		std::optional<PrefetcherDisabler> disabler;
+		try {
+			disabler.emplace();
+		} catch (const std::exception &e) {
+			std::printf("ipc::benchmarkPrefetch: Prefetchers cannot be toggled on this host, skipping: %s\n", e.what());
+			return;
+		}
+		std::printf("ipc::benchmarkPrefetch: Hardware prefetchers disabled\n\n");
+		benchmarkPrefetchPatterns(durationMeasurer, report, buffer, " prefetchers off");
+	}
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+struct PrefetchOptions {
+	// Also run every pattern with the hardware prefetchers disabled through their MSRs (requires MSR write access: WinRing0 on Windows, the msr module as root or with CAP_SYS_RAWIO on Linux)
+	bool togglePrefetchers = false;
+};
+
+// Sweeps load patterns over a buffer much larger than the last level cache: stride, direction, interleaved streams and page order
+// Each pattern is reported both as a dependent chain (latency) and as independent loads (bandwidth), in cycles per accessed cache line
+void benchmarkPrefetch(const DurationMeasurer &durationMeasurer, const Report &report, const PrefetchOptions &options);
+
+}
\ No newline at end of file
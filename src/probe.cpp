@@ -0,0 +1,379 @@
+#include "probe.hpp"
+#include "peak.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+namespace ipc {
+
+static inline constexpr size_t probeLineSize = 64;
+static inline constexpr size_t probeAluOpCount = 1 << 14;
+static inline constexpr size_t probeChaseCount = 1 << 12;
+static inline constexpr size_t probeIterationCount = 1 << 4;
+// Every bandwidth sample reads the whole DRAM buffer
+static inline constexpr size_t probeBandwidthIterationCount = 2;
+// DRAM buffer is 4 times the last level cache within these bounds: it stays resident for the lifetime of the daemon
+static inline constexpr size_t probeMinDramSize = static_cast<size_t>(1) << 26;
+static inline constexpr size_t probeMaxDramSize = static_cast<size_t>(1) << 30;
+
+static volatile uint64_t probeSink;
+
+struct Probe {
+	// Metric label
+	const char *name;
+	const char *op;
+	size_t bufferSize;
+	std::function<Statistics (void)> run;
+};
+
+struct ProbeHistory {
+	Statistics latest;
+	// Means of the previous rounds, oldest first
+	std::deque<Duration> previous;
+};
+
+// Every line of the buffer starts with a pointer to the next one, in a single random cycle
+static void writeProbeChase(Buffer &buffer) {
+	auto lineCount = buffer.size / probeLineSize;
+	std::vector<size_t> order(lineCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), std::mt19937_64(0x960BE));
+
+	auto bytes = reinterpret_cast<uint8_t*>(buffer.data);
+	for (size_t i = 0; i < lineCount; i++)
+		*reinterpret_cast<void**>(bytes + order[i] * probeLineSize) = bytes + order[(i + 1) % lineCount] * probeLineSize;
+}
+
+// cursor: where the previous round left the chase
+static Statistics measureProbeChase(const DurationMeasurer &durationMeasurer, void *&cursor) {
+	return sampleDurations(probeIterationCount, [&]() {
+		return durationMeasurer.measure([&]() {
+			auto p = cursor;
+			for (size_t i = 0; i < probeChaseCount; i++)
+				p = *reinterpret_cast<void * const *>(p);
+			cursor = p;
+		});
+	}) / probeChaseCount;
+}
+
+static double medianOf(std::vector<double> values) {
+	std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+	return values[values.size() / 2];
+}
+
+static std::string escapeProbeLabel(const std::string &value) {
+	std::string res;
+	for (auto c : value) {
+		if (c == '\\' || c == '"')
+			res += '\\';
+		if (c == '\n') {
+			res += "\\n";
+			continue;
+		}
+		res += c;
+	}
+	return res;
+}
+
+// Prometheus text exposition format
+static std::string formatProbeMetrics(const Report &report, const ProbeOptions &options, const std::vector<Probe> &probes, const std::vector<ProbeHistory> &histories,
+	size_t roundCount, double roundSeconds, double dutyCycle) {
+	std::stringstream commonLabels;
+	commonLabels << "cpu=\"" << escapeProbeLabel(report.cpuInfo) << "\"";
+	if (options.core)
+		commonLabels << ",core=\"" << *options.core << "\"";
+
+	std::stringstream ss;
+	auto perProbe = [&](const char *metric, const char *type, const char *help, const std::function<double (const ProbeHistory &history)> &value) {
+		ss << "# HELP " << metric << " " << help << "\n";
+		ss << "# TYPE " << metric << " " << type << "\n";
+		for (size_t i = 0; i < probes.size(); i++)
+			ss << metric << "{probe=\"" << probes[i].name << "\"," << commonLabels.str() << "} " << value(histories[i]) << "\n";
+	};
+	auto single = [&](const char *metric, const char *type, const char *help, double value) {
+		ss << "# HELP " << metric << " " << help << "\n";
+		ss << "# TYPE " << metric << " " << type << "\n";
+		ss << metric << "{" << commonLabels.str() << "} " << value << "\n";
+	};
+	auto baseline = [](const ProbeHistory &history, const std::function<double (const Duration &duration)> &field) {
+		if (history.previous.empty())
+			return field(history.latest.mean);
+		std::vector<double> values;
+		for (auto &duration : history.previous)
+			values.emplace_back(field(duration));
+		return medianOf(std::move(values));
+	};
+	auto cycles = [](const Duration &duration) {
+		return duration.lengthCycles;
+	};
+	auto frequency = [](const Duration &duration) {
+		return duration.inferredFrequencyMHz();
+	};
+
+	ss.precision(6);
+	perProbe("ipc_probe_cycles", "gauge", "Cycles per operation of the latest round (per load for latency probes, per 64-byte line for bandwidth)", [&](const ProbeHistory &history) {
+		return history.latest.mean.lengthCycles;
+	});
+	perProbe("ipc_probe_cycles_stddev", "gauge", "Standard deviation of the cycles per operation over the samples of the latest round", [&](const ProbeHistory &history) {
+		return history.latest.stddev.lengthCycles;
+	});
+	perProbe("ipc_probe_seconds", "gauge", "Seconds per operation of the latest round", [&](const ProbeHistory &history) {
+		return history.latest.mean.lengthSeconds;
+	});
+	perProbe("ipc_probe_frequency_mhz", "gauge", "Core frequency inferred over the latest round", [&](const ProbeHistory &history) {
+		return history.latest.mean.inferredFrequencyMHz();
+	});
+	perProbe("ipc_probe_baseline_cycles", "gauge", "Median cycles per operation over the previous rounds of the rolling window", [&](const ProbeHistory &history) {
+		return baseline(history, cycles);
+	});
+	perProbe("ipc_probe_baseline_frequency_mhz", "gauge", "Median inferred frequency over the previous rounds of the rolling window", [&](const ProbeHistory &history) {
+		return baseline(history, frequency);
+	});
+	perProbe("ipc_probe_drift_ratio", "gauge", "Latest cycles per operation over the baseline, above 1 is slower", [&](const ProbeHistory &history) {
+		auto base = baseline(history, cycles);
+		return base > 0.0 ? history.latest.mean.lengthCycles / base : 1.0;
+	});
+	single("ipc_probe_rounds_total", "counter", "Probe rounds completed since start", static_cast<double>(roundCount));
+	single("ipc_probe_round_seconds", "gauge", "Wall time of the latest round", roundSeconds);
+	single("ipc_probe_duty_cycle_ratio", "gauge", "Share of wall time spent probing, latest round and the pause after it", dutyCycle);
+	single("ipc_probe_last_round_timestamp_seconds", "gauge", "Unix time of the end of the latest round",
+		std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count());
+	return ss.str();
+}
+
+// Readers never see a partially written file
+static void writeProbeTextfile(const std::string &path, const std::string &metrics) {
+	auto tmpPath = path + ".tmp";
+	{
+		std::ofstream output(tmpPath, std::ios::out | std::ios::trunc);
+		output << metrics;
+		if (!output.good())
+			throw std::runtime_error("ipc::writeProbeTextfile: Could not write '" + tmpPath + "'");
+	}
+	#ifdef _WIN32
+	// rename does not replace existing files there
+	std::remove(path.c_str());
+	#endif
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+		throw std::runtime_error("ipc::writeProbeTextfile: Could not rename '" + tmpPath + "' to '" + path + "'");
+}
+
+// Serves the latest metrics to every client that connects while the daemon waits for the next round
+class ProbeSocket
+{
+	std::string m_path;
+	int m_fd = -1;
+
+public:
+	ProbeSocket(const std::string &path) :
+		m_path(path)
+	{
+		#ifdef _WIN32
+
+		throw std::runtime_error("ipc::ProbeSocket(_WIN32): Unix sockets are not supported on this platform, use the textfile instead");
+
+		#else
+
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+			throw std::runtime_error("ipc::ProbeSocket: Socket path '" + path + "' is too long");
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+		m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_fd < 0)
+			throw std::runtime_error(std::string("ipc::ProbeSocket: socket: ") + strerror(errno));
+		// A previous instance may have left its socket behind, anything else at that path is not ours to remove
+		struct stat existing;
+		if (lstat(path.c_str(), &existing) == 0) {
+			if (!S_ISSOCK(existing.st_mode)) {
+				close(m_fd);
+				throw std::runtime_error("ipc::ProbeSocket: '" + path + "' exists and is not a socket");
+			}
+			// Only a socket nobody listens on anymore is stale
+			auto peer = socket(AF_UNIX, SOCK_STREAM, 0);
+			auto connected = peer >= 0 && connect(peer, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+			auto error = errno;
+			if (peer >= 0)
+				close(peer);
+			if (connected || error != ECONNREFUSED) {
+				close(m_fd);
+				if (connected)
+					throw std::runtime_error("ipc::ProbeSocket: A probe daemon is already running on '" + path + "'");
+				throw std::runtime_error("ipc::ProbeSocket: Could not tell whether '" + path + "' is stale: " + strerror(error));
+			}
+			unlink(path.c_str());
+		}
+		if (bind(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(m_fd, 16) != 0 || fcntl(m_fd, F_SETFL, O_NONBLOCK) != 0) {
+			std::string error = strerror(errno);
+			close(m_fd);
+			throw std::runtime_error("ipc::ProbeSocket: Could not listen on '" + path + "': " + error);
+		}
+
+		#endif
+	}
+
+	ProbeSocket(const ProbeSocket &other) = delete;
+	ProbeSocket& operator=(const ProbeSocket &other) = delete;
+
+	~ProbeSocket(void) {
+		#ifndef _WIN32
+		if (m_fd >= 0) {
+			close(m_fd);
+			unlink(m_path.c_str());
+		}
+		#endif
+	}
+
+	void serveUntil(std::chrono::steady_clock::time_point deadline, const std::string &metrics) {
+		#ifdef _WIN32
+
+		std::this_thread::sleep_until(deadline);
+		(void)metrics;
+
+		#else
+
+		while (true) {
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (remaining <= 0)
+				return;
+			pollfd pending{
+				.fd = m_fd,
+				.events = POLLIN,
+				.revents = 0
+			};
+			if (poll(&pending, 1, static_cast<int>(std::min<decltype(remaining)>(remaining, 1 << 30))) <= 0)
+				continue;
+			auto client = accept(m_fd, nullptr, nullptr);
+			if (client < 0)
+				continue;
+			// Best effort: a client hanging up early is not the daemon's problem
+			for (size_t sent = 0; sent < metrics.size();) {
+				auto res = send(client, metrics.data() + sent, metrics.size() - sent, MSG_NOSIGNAL);
+				if (res <= 0)
+					break;
+				sent += static_cast<size_t>(res);
+			}
+			close(client);
+		}
+
+		#endif
+	}
+};
+
+void runProbes(const DurationMeasurer &durationMeasurer, const Report &report, const ProbeOptions &options) {
+	if (!(options.dutyCyclePercent > 0.0 && options.dutyCyclePercent <= 100.0) || options.intervalSeconds < 0.0 || options.baselineWindow == 0) {
+		std::stringstream ss;
+		ss << "ipc::runProbes: Duty cycle must be in ]0, 100], interval positive and baseline window at least 1, got " << options.dutyCyclePercent << "%, " << options.intervalSeconds << " s and " << options.baselineWindow;
+		throw std::runtime_error(ss.str());
+	}
+	if (options.core) {
+		pinThreadToCore(*options.core);
+		std::printf("ipc::runProbes: Pinned to core %zu\n", *options.core);
+	}
+	std::unique_ptr<ProbeSocket> socket;
+	if (!options.socketPath.empty())
+		socket = std::make_unique<ProbeSocket>(options.socketPath);
+
+	// Buffers are set up once and stay resident: only the probes themselves run every round
+	auto llcSize = getDataCacheSizes().rbegin()->second;
+	auto llc = Buffer(std::max(llcSize / 2 / peakReadGranularity * peakReadGranularity, peakReadGranularity));
+	auto dram = Buffer(std::clamp(llcSize * 4, probeMinDramSize, probeMaxDramSize) / peakReadGranularity * peakReadGranularity);
+	writeProbeChase(llc);
+	writeProbeChase(dram);
+	void *llcCursor = llc.data;
+	void *dramCursor = dram.data;
+	auto readKernel = getWidestPeakRead();
+
+	std::vector<Probe> probes = {
+		{"alu_latency", "Probe ALU latency (u64 * u64 chain)", 0, [&]() {
+			return sampleDurations(probeIterationCount, [&]() {
+				return durationMeasurer.measure([&]() {
+					uint64_t acc = probeSink;
+					for (size_t i = 0; i < probeAluOpCount; i++) {
+						acc *= 0x9E3779B97F4A7C15;
+						// Opaque to the optimizer: keeps the chain from being folded
+						asm volatile("" : "+r"(acc));
+					}
+					probeSink = acc;
+				});
+			}) / probeAluOpCount;
+		}},
+		{"llc_latency", "Probe last level cache latency", llc.size, [&]() {
+			// Brings the working set back in, other tenants had the whole pause to evict it
+			probeSink = readKernel(llc.data, llc.size, 1);
+			return measureProbeChase(durationMeasurer, llcCursor);
+		}},
+		{"dram_latency", "Probe DRAM latency", dram.size, [&]() {
+			return measureProbeChase(durationMeasurer, dramCursor);
+		}},
+		{"dram_bandwidth", "Probe DRAM read bandwidth", dram.size, [&]() {
+			return sampleDurations(probeBandwidthIterationCount, [&]() {
+				return durationMeasurer.measure([&]() {
+					probeSink = readKernel(dram.data, dram.size, 1);
+				});
+			}, false) / (dram.size / probeLineSize);
+		}}
+	};
+	std::vector<ProbeHistory> histories(probes.size());
+
+	for (size_t round = 1; options.roundCount == 0 || round <= options.roundCount; round++) {
+		auto roundBegin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < probes.size(); i++) {
+			auto &history = histories[i];
+			if (history.latest.sampleCount > 0) {
+				history.previous.emplace_back(history.latest.mean);
+				if (history.previous.size() > options.baselineWindow)
+					history.previous.pop_front();
+			}
+			history.latest = probes[i].run();
+			// Samples are only needed for the first round, which goes to the report
+			if (round == 1)
+				report.writeRow(probes[i].op, "Probe", probes[i].bufferSize, history.latest);
+			history.latest.samples.clear();
+		}
+		auto roundEnd = std::chrono::steady_clock::now();
+		auto roundSeconds = std::chrono::duration<double>(roundEnd - roundBegin).count();
+
+		// Whichever is longer: the interval, or the pause that keeps the duty cycle under its bound
+		auto pauseSeconds = std::max(options.intervalSeconds - roundSeconds, roundSeconds * (100.0 / options.dutyCyclePercent - 1.0));
+		auto dutyCycle = roundSeconds / (roundSeconds + pauseSeconds);
+
+		auto metrics = formatProbeMetrics(report, options, probes, histories, round, roundSeconds, dutyCycle);
+		for (size_t i = 0; i < probes.size(); i++) {
+			auto &latest = histories[i].latest.mean;
+			std::printf("%s, Probe = %s, round %zu: avg = %g cycles, %g ns (%g MHz)\n", report.meta, probes[i].name, round, latest.lengthCycles, latest.lengthSeconds * 1.0e9, latest.inferredFrequencyMHz());
+		}
+		if (!options.textfilePath.empty())
+			writeProbeTextfile(options.textfilePath, metrics);
+		std::printf("ipc::runProbes: Round %zu took %g ms, next one in %g s (duty cycle = %g%%)\n", round, roundSeconds * 1.0e3, pauseSeconds, dutyCycle * 100.0);
+
+		if (options.roundCount != 0 && round == options.roundCount)
+			break;
+		auto deadline = roundEnd + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(pauseSeconds));
+		if (socket)
+			socket->serveUntil(deadline, metrics);
+		else
+			std::this_thread::sleep_until(deadline);
+	}
+	std::printf("\n");
+}
+
+}
\ No newline at end of file
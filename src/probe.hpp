@@ -0,0 +1,32 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+struct ProbeOptions {
+	// Logical processor the probes are pinned to, the scheduler picks otherwise
+	std::optional<size_t> core;
+	// Upper bound on the share of wall time spent probing, in percent
+	double dutyCyclePercent = 0.5;
+	// Minimum time between the start of two rounds
+	double intervalSeconds = 60.0;
+	// The rolling baseline of a probe is the median of this many previous rounds
+	size_t baselineWindow = 60;
+	// 0 runs until the process is killed
+	size_t roundCount = 0;
+	// Prometheus textfile (e.g. for the node_exporter textfile collector), replaced atomically every round. Empty disables it
+	std::string textfilePath = "./ipc-benchmark.prom";
+	// Unix socket serving the latest metrics to every client that connects. Optional
+	std::string socketPath;
+};
+
+// Keeps the calibrated measurer alive and periodically runs a small set of probes: ALU latency, last level cache and DRAM latency, DRAM bandwidth
+// Publishes the latest results, their rolling baselines and drift ratios in the Prometheus text format
+// The first round also goes to the report, so that hosts can be compared against each other with the compare mode
+void runProbes(const DurationMeasurer &durationMeasurer, const Report &report, const ProbeOptions &options);
+
+}
\ No newline at end of file
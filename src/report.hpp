@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "clock.hpp"
+#include "sampling.hpp"
+
+namespace ipc {
+
+// Rows of report.csv, shared by every benchmark family so that reports stay comparable
+// Fields must not contain commas
+struct Report {
+	const char * const meta;
+	const char * const cpuInfo;
+	std::ostream &output;
+	// Optional: samples behind rows written from Statistics, one line each (see the compare mode)
+	std::ostream * const trace = nullptr;
+	// Rows with more samples trace this many, evenly spread, so that sample-heavy modes keep traces small enough for compare to load
+	const size_t traceSampleLimit = defaultTraceSampleLimit;
+
+	static inline constexpr size_t defaultTraceSampleLimit = 1 << 10;
+
+	static inline constexpr auto header = "Meta, CPU model, Operation, Execution, Buffer size [byte], Cycle count, Frequency [MHz]";
+	static inline constexpr auto traceHeader = "Meta, CPU model, Operation, Execution, Buffer size [byte], Sample, Cycle count, Frequency [MHz]";
+
+	// Rows of anything but cycles carry their unit at the end of the execution, e.g. "Derived [branch]"
+	static bool isFigure(std::string_view execution) {
+		return execution.ends_with(']');
+	}
+
+	// <name>.csv -> <name>.trace.csv
+	static std::string tracePath(const std::string &reportPath) {
+		constexpr std::string_view extension = ".csv";
+		if (reportPath.ends_with(extension))
+			return reportPath.substr(0, reportPath.size() - extension.size()) + ".trace.csv";
+		return reportPath + ".trace.csv";
+	}
+
+	// Same report, rows tagged with another meta (e.g. with settings only a mode knows about)
+	Report withMeta(const char *otherMeta) const {
+		return Report{
+			.meta = otherMeta,
+			.cpuInfo = cpuInfo,
+			.output = output,
+			.trace = trace,
+			.traceSampleLimit = traceSampleLimit
+		};
+	}
+
+	void writeHeader(void) const {
+		output << header << std::endl;
+		if (trace != nullptr)
+			*trace << traceHeader << std::endl;
+	}
+
+	void writeRow(const std::string &op, const std::string &execution, size_t bufferSize, const Duration &duration) const {
+		output << meta << ", " << cpuInfo << ", " << op << ", " << execution << ", " << bufferSize << ", " << duration.lengthCycles << ", " << duration.inferredFrequencyMHz() << std::endl;
+	}
+
+	// Value in the cycle count column, tagged with its unit and without a frequency: compare skips it
+	void writeFigure(const std::string &op, const std::string &execution, size_t bufferSize, double value, const char *unit) const {
+		output << meta << ", " << cpuInfo << ", " << op << ", " << execution << " [" << unit << "], " << bufferSize << ", " << value << ", " << std::endl;
+	}
+
+	// The row holds the mean, the trace every sample, or traceSampleLimit of them keeping their index
+	void writeRow(const std::string &op, const std::string &execution, size_t bufferSize, const Statistics &stats) const {
+		writeRow(op, execution, bufferSize, stats.mean);
+		if (trace == nullptr)
+			return;
+		auto count = std::min(stats.samples.size(), traceSampleLimit);
+		for (size_t j = 0; j < count; j++) {
+			auto i = j * stats.samples.size() / count;
+			auto &sample = stats.samples[i];
+			*trace << meta << ", " << cpuInfo << ", " << op << ", " << execution << ", " << bufferSize << ", " << i << ", " << sample.lengthCycles << ", " << sample.inferredFrequencyMHz() << '\n';
+		}
+		trace->flush();
+	}
+};
+
+}
\ No newline at end of file
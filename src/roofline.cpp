@@ -0,0 +1,179 @@
+#include "roofline.hpp"
+#include "peak.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+
+namespace ipc {
+
+static inline constexpr size_t rooflineLineSize = 64;
+static inline constexpr size_t rooflineMaddIterationCount = 1 << 12;
+static inline constexpr size_t rooflineComputeIterationCount = 1 << 8;
+static inline constexpr size_t rooflineBandwidthIterationCount = 1 << 4;
+// Every bandwidth sample reads at least this much, repeating over small buffers
+static inline constexpr size_t rooflineBytesPerSample = static_cast<size_t>(1) << 26;
+static inline constexpr size_t rooflineMinDramSize = static_cast<size_t>(1) << 28;
+
+static volatile double rooflineSink;
+static volatile uint64_t rooflineReadSink;
+
+struct ComputeCeiling {
+	std::string name;
+	double opsPerCycle;
+};
+
+struct MemoryCeiling {
+	std::string name;
+	size_t size;
+	double bytesPerCycle;
+};
+
+struct PeakKernel {
+	const char *name;
+	size_t laneCount;
+	size_t accumulatorCount;
+	bool available;
+	// Returns a reduction of the accumulators
+	std::function<double (size_t iterationCount)> run;
+};
+
+static std::vector<PeakKernel> getPeakKernels(void) {
+	// Multiply-add constants: accumulators converge to c / (1 - m)
+	constexpr double m = 0.999;
+	constexpr double c = 0.001;
+	bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	bool avx512 = __builtin_cpu_supports("avx512f");
+
+	return {
+		{"f64 multiply-add scalar", 1, peakSplitAccumulatorCount, true, [](size_t n) { return peakMaddF64Scalar(m, c, n); }},
+		{"f32 multiply-add scalar", 1, peakSplitAccumulatorCount, true, [](size_t n) { return static_cast<double>(peakMaddF32Scalar(m, c, n)); }},
+		{"f64 multiply-add SSE2", 2, peakSplitAccumulatorCount, true, [](size_t n) { return peakMaddF64Sse2(m, c, n); }},
+		{"f32 multiply-add SSE2", 4, peakSplitAccumulatorCount, true, [](size_t n) { return static_cast<double>(peakMaddF32Sse2(m, c, n)); }},
+		{"f64 FMA AVX2", 4, peakFmaAccumulatorCount, avx2, [](size_t n) { return peakMaddF64Avx2(m, c, n); }},
+		{"f32 FMA AVX2", 8, peakFmaAccumulatorCount, avx2, [](size_t n) { return static_cast<double>(peakMaddF32Avx2(m, c, n)); }},
+		{"f64 FMA AVX-512", 8, peakFmaAccumulatorCount, avx512, [](size_t n) { return peakMaddF64Avx512(m, c, n); }},
+		{"f32 FMA AVX-512", 16, peakFmaAccumulatorCount, avx512, [](size_t n) { return static_cast<double>(peakMaddF32Avx512(m, c, n)); }}
+	};
+}
+
+static ComputeCeiling measureComputeCeiling(const DurationMeasurer &durationMeasurer, const Report &report, const PeakKernel &kernel) {
+	// Two operations (multiply and add) per lane per accumulator per iteration
+	auto opCountPerLane = rooflineMaddIterationCount * kernel.accumulatorCount * 2;
+	auto opCount = opCountPerLane * kernel.laneCount;
+
+	auto perOp = sampleDurations(rooflineComputeIterationCount, [&]() {
+		return durationMeasurer.measure([&]() {
+			rooflineSink = kernel.run(rooflineMaddIterationCount);
+		});
+	}) / opCount;
+
+	std::printf("%s, Op = %s: avg = %g cycles per operation, %g operations per cycle (%g MHz)\n", report.meta, kernel.name, perOp.mean.lengthCycles, 1.0 / perOp.mean.lengthCycles, perOp.mean.inferredFrequencyMHz());
+	report.writeRow(kernel.name, "Compute peak", 0, perOp);
+	return ComputeCeiling{
+		.name = kernel.name,
+		.opsPerCycle = 1.0 / perOp.mean.lengthCycles
+	};
+}
+
+static MemoryCeiling measureMemoryCeiling(const DurationMeasurer &durationMeasurer, const Report &report, const Buffer &buffer, size_t size, const std::string &name) {
+	static auto readKernel = getWidestPeakRead();
+
+	size = std::max(size / peakReadGranularity * peakReadGranularity, peakReadGranularity);
+	assertBufferSizeAtLeast(buffer, size);
+	auto repeatCount = std::max<size_t>(rooflineBytesPerSample / size, 1);
+	auto lineCount = size / rooflineLineSize * repeatCount;
+
+	auto perLine = sampleDurations(rooflineBandwidthIterationCount, [&]() {
+		return durationMeasurer.measure([&]() {
+			rooflineReadSink = readKernel(buffer.data, size, repeatCount);
+		});
+	}) / lineCount;
+
+	auto bytesPerCycle = static_cast<double>(rooflineLineSize) / perLine.mean.lengthCycles;
+	std::printf("%s, Op = Read %s, buffer size = %zu bytes: avg = %g cycles per line, %g bytes per cycle, %g GB/s (%g MHz)\n", report.meta, name.c_str(), size, perLine.mean.lengthCycles,
+		bytesPerCycle, static_cast<double>(rooflineLineSize) / perLine.mean.lengthSeconds / 1.0e9, perLine.mean.inferredFrequencyMHz());
+	report.writeRow("Read " + name, "Bandwidth", size, perLine);
+	return MemoryCeiling{
+		.name = name,
+		.size = size,
+		.bytesPerCycle = bytesPerCycle
+	};
+}
+
+static void writeRoofline(const Report &report, const RooflineOptions &options, const std::vector<ComputeCeiling> &computeCeilings, const std::vector<MemoryCeiling> &memoryCeilings) {
+	std::ofstream output(options.outputPath, std::ios::out);
+	if (!output.good())
+		throw std::runtime_error("ipc::benchmarkRoofline: Could not open '" + options.outputPath + "' for writing");
+
+	output << "Meta, CPU model, Kind, Name, Compute ceiling [op/cycle], Memory ceiling [byte/cycle], Arithmetic intensity [op/byte], Attainable [op/cycle], Bound" << std::endl;
+	auto row = [&](const char *kind, const std::string &name, const std::string &compute, const std::string &memory, const std::string &intensity, const std::string &attainable, const char *bound) {
+		output << report.meta << ", " << report.cpuInfo << ", " << kind << ", " << name << ", " << compute << ", " << memory << ", " << intensity << ", " << attainable << ", " << bound << std::endl;
+	};
+	auto str = [](double v) {
+		std::stringstream ss;
+		ss << v;
+		return ss.str();
+	};
+
+	for (auto &compute : computeCeilings)
+		row("Compute ceiling", compute.name, str(compute.opsPerCycle), "", "", str(compute.opsPerCycle), "Compute");
+	for (auto &memory : memoryCeilings)
+		row("Memory ceiling", memory.name, "", str(memory.bytesPerCycle), "", "", "Memory");
+
+	// Intensity past which a kernel stops being memory bound
+	for (auto &compute : computeCeilings) {
+		for (auto &memory : memoryCeilings)
+			row("Ridge point", compute.name + " / " + memory.name, str(compute.opsPerCycle), str(memory.bytesPerCycle), str(compute.opsPerCycle / memory.bytesPerCycle), str(compute.opsPerCycle), "Ridge");
+	}
+
+	// Kernels are placed under the highest compute ceiling, for every level their working set may live in
+	auto top = *std::max_element(computeCeilings.begin(), computeCeilings.end(), [](const ComputeCeiling &a, const ComputeCeiling &b) {
+		return a.opsPerCycle < b.opsPerCycle;
+	});
+	for (auto &kernel : options.kernels) {
+		for (auto &memory : memoryCeilings) {
+			auto memoryBound = kernel.intensity * memory.bytesPerCycle;
+			auto isMemoryBound = memoryBound < top.opsPerCycle;
+			row("Kernel", kernel.name + " / " + memory.name, str(top.opsPerCycle), str(memory.bytesPerCycle), str(kernel.intensity), str(isMemoryBound ? memoryBound : top.opsPerCycle), isMemoryBound ? "Memory" : "Compute");
+		}
+	}
+}
+
+void benchmarkRoofline(const DurationMeasurer &durationMeasurer, const Report &report, const RooflineOptions &options) {
+	std::vector<ComputeCeiling> computeCeilings;
+	for (auto &kernel : getPeakKernels()) {
+		if (!kernel.available) {
+			std::printf("ipc::benchmarkRoofline: %s is not supported by this host, skipping\n", kernel.name);
+			continue;
+		}
+		computeCeilings.emplace_back(measureComputeCeiling(durationMeasurer, report, kernel));
+	}
+	std::printf("\n");
+
+	auto cacheSizes = getDataCacheSizes();
+	auto dramSize = std::max(cacheSizes.rbegin()->second * 4, rooflineMinDramSize);
+	auto buffer = Buffer(dramSize);
+	// Fault every page in beforehand, page faults are not what is measured here
+	std::memset(buffer.data, 1, buffer.size);
+
+	// Full sweep first, for the curve
+	for (size_t size = 1 << 12; size <= dramSize; size *= 2)
+		measureMemoryCeiling(durationMeasurer, report, buffer, size, "sweep");
+	std::printf("\n");
+
+	// Each level is measured with a working set of half its size: well past the previous level on any sane hierarchy
+	std::vector<MemoryCeiling> memoryCeilings;
+	for (auto &[level, size] : cacheSizes) {
+		std::stringstream name;
+		name << "L" << level;
+		memoryCeilings.emplace_back(measureMemoryCeiling(durationMeasurer, report, buffer, size / 2, name.str()));
+	}
+	memoryCeilings.emplace_back(measureMemoryCeiling(durationMeasurer, report, buffer, dramSize, "DRAM"));
+	std::printf("\n");
+
+	writeRoofline(report, options, computeCeilings, memoryCeilings);
+	std::printf("ipc::benchmarkRoofline: Roofline written to '%s'\n\n", options.outputPath.c_str());
+}
+
+}
\ No newline at end of file
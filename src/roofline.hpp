@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "benchmark.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+// A kernel of the user's, placed on the roofline by its arithmetic intensity
+struct RooflineKernel {
+	std::string name;
+	// Operations per byte moved from memory
+	double intensity;
+};
+
+struct RooflineOptions {
+	std::string outputPath = "./roofline.csv";
+	std::vector<RooflineKernel> kernels;
+};
+
+// Measures compute ceilings (multiply-add throughput per ISA level) and memory ceilings (read bandwidth per cache level and DRAM)
+// Measurements go to the report, the roofline dataset (ceilings, ridge points and kernels) goes to options.outputPath
+void benchmarkRoofline(const DurationMeasurer &durationMeasurer, const Report &report, const RooflineOptions &options);
+
+}
\ No newline at end of file
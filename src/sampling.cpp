@@ -0,0 +1,70 @@
+#include "sampling.hpp"
+
+#include <cmath>
+
+namespace ipc {
+
+Statistics Statistics::operator/(size_t n) const {
+	std::vector<Duration> perOpSamples;
+	perOpSamples.reserve(samples.size());
+	for (auto &sample : samples)
+		perOpSamples.emplace_back(sample / n);
+
+	return Statistics{
+		.sampleCount = sampleCount,
+		.mean = mean / n,
+		.stddev = stddev / n,
+		.min = min / n,
+		.median = median / n,
+		.max = max / n,
+		.samples = std::move(perOpSamples)
+	};
+}
+
+Statistics Statistics::compute(std::vector<Duration> samples) {
+	if (samples.empty())
+		throw std::runtime_error("ipc::Statistics::compute: No samples");
+
+	auto count = static_cast<double>(samples.size());
+	Duration mean = {
+		.lengthCycles = 0.0,
+		.lengthSeconds = 0.0
+	};
+	for (auto &sample : samples) {
+		mean.lengthCycles += sample.lengthCycles / count;
+		mean.lengthSeconds += sample.lengthSeconds / count;
+	}
+
+	Duration variance = {
+		.lengthCycles = 0.0,
+		.lengthSeconds = 0.0
+	};
+	if (samples.size() > 1) {
+		for (auto &sample : samples) {
+			auto dc = sample.lengthCycles - mean.lengthCycles;
+			auto ds = sample.lengthSeconds - mean.lengthSeconds;
+			variance.lengthCycles += dc * dc / (count - 1.0);
+			variance.lengthSeconds += ds * ds / (count - 1.0);
+		}
+	}
+
+	auto sorted = samples;
+	std::sort(sorted.begin(), sorted.end(), [](const Duration &a, const Duration &b) {
+		return a.lengthCycles < b.lengthCycles;
+	});
+
+	return Statistics{
+		.sampleCount = samples.size(),
+		.mean = mean,
+		.stddev = Duration{
+			.lengthCycles = std::sqrt(variance.lengthCycles),
+			.lengthSeconds = std::sqrt(variance.lengthSeconds)
+		},
+		.min = sorted.front(),
+		.median = sorted[sorted.size() / 2],
+		.max = sorted.back(),
+		.samples = std::move(samples)
+	};
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include "clock.hpp"
+
+namespace ipc {
+
+struct Statistics {
+	size_t sampleCount;
+	Duration mean;
+	Duration stddev;
+	Duration min;
+	Duration median;
+	Duration max;
+	// In the order they were taken
+	std::vector<Duration> samples;
+
+	// Per-operation statistics out of per-sample ones
+	Statistics operator/(size_t n) const;
+
+	// Order statistics (min, median, max) are taken on cycle counts
+	static Statistics compute(std::vector<Duration> samples);
+};
+
+// Sample is `Duration (void)`: performs any per-sample setup, then calls DurationMeasurer::measure on the code to time
+// With warmup, every sample is taken twice and only the second one is kept
+template <typename Sample>
+Statistics sampleDurations(size_t iterationCount, Sample &&sample, bool warmup = true) {
+	std::vector<Duration> durations(iterationCount);
+	for (size_t inst = 0; inst < iterationCount; inst++) {
+		if (warmup)
+			durations[inst] = sample();
+		durations[inst] = sample();
+	}
+	return Statistics::compute(std::move(durations));
+}
+
+}
\ No newline at end of file
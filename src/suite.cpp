@@ -0,0 +1,87 @@
+#include "suite.hpp"
+
+#include <algorithm>
+
+namespace ipc {
+
+void Suite::add(BenchmarkCase benchmarkCase) {
+	if (!benchmarkCase.run)
+		throw std::runtime_error("ipc::Suite::add: Case '" + benchmarkCase.op + "' has nothing to run");
+	if (benchmarkCase.opCount == 0 || benchmarkCase.iterationCount == 0)
+		throw std::runtime_error("ipc::Suite::add: Case '" + benchmarkCase.op + "' must have at least a single op and a single iteration");
+	m_cases.emplace_back(std::move(benchmarkCase));
+}
+
+Duration Suite::getCallOverhead(const DurationMeasurer &durationMeasurer) {
+	static const std::function<void (void)> empty = []() {};
+	// Read back like a registered case, so that the call cannot be resolved at compile time
+	const std::function<void (void)> * volatile call = &empty;
+	return sampleDurations(callOverheadIterationCount, [&]() {
+		return durationMeasurer.measure(*call);
+	}).median;
+}
+
+std::vector<Statistics> Suite::run(const DurationMeasurer &durationMeasurer, const Report &report) const {
+	auto callOverhead = getCallOverhead(durationMeasurer);
+	std::printf("%s, Case call overhead: %g cycles, %g ns\n", report.meta, callOverhead.lengthCycles, callOverhead.lengthSeconds * 1.0e9);
+
+	std::vector<Statistics> res;
+	for (auto &benchmarkCase : m_cases) {
+		auto stats = sampleDurations(benchmarkCase.iterationCount, [&]() {
+			if (benchmarkCase.setup)
+				benchmarkCase.setup();
+			// Clamped like DurationMeasurer::measure does with its own overhead
+			auto sample = durationMeasurer.measure(benchmarkCase.run);
+			return Duration{
+				.lengthCycles = std::max(sample.lengthCycles - callOverhead.lengthCycles, 0.0),
+				.lengthSeconds = std::max(sample.lengthSeconds - callOverhead.lengthSeconds, 0.0)
+			};
+		}) / benchmarkCase.opCount;
+
+		std::printf("%s, Op = %s %s: avg = %g cycles per operation, stddev = %g, median = %g (%g MHz)\n", report.meta, benchmarkCase.op.c_str(), benchmarkCase.execution.c_str(),
+			stats.mean.lengthCycles, stats.stddev.lengthCycles, stats.median.lengthCycles, stats.mean.inferredFrequencyMHz());
+		report.writeRow(benchmarkCase.op, benchmarkCase.execution, benchmarkCase.bufferSize, stats);
+		res.emplace_back(stats);
+	}
+	return res;
+}
+
+std::string Session::prepareHost(bool realtime) {
+	auto res = ipc::getCPUInfo();
+
+	// Necessary to accurately estimate CPUs frequency from cycle count and std::chrono
+	if (realtime)
+		setRealtime();
+
+	return res;
+}
+
+Session::Session(const std::string &meta, const std::string &reportPath, bool realtime, bool trace, size_t traceSampleLimit) :
+	m_meta(meta),
+	m_cpuInfo(prepareHost(realtime)),
+	m_durationMeasurer(),
+	m_output(reportPath, std::ios::out),
+	m_traceOutput(),
+	m_report{
+		.meta = m_meta.c_str(),
+		.cpuInfo = m_cpuInfo.c_str(),
+		.output = m_output,
+		.trace = trace ? &m_traceOutput : nullptr,
+		.traceSampleLimit = traceSampleLimit
+	}
+{
+	if (traceSampleLimit == 0)
+		throw std::runtime_error("ipc::Session: Trace sample limit must be at least 1");
+	if (!m_output.good())
+		throw std::runtime_error("ipc::Session: Could not open '" + reportPath + "' for writing");
+	if (trace) {
+		m_traceOutput.open(Report::tracePath(reportPath), std::ios::out);
+		if (!m_traceOutput.good())
+			throw std::runtime_error("ipc::Session: Could not open '" + Report::tracePath(reportPath) + "' for writing");
+	}
+
+	m_durationMeasurer.calibrate();
+	m_report.writeHeader();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include "clock.hpp"
+#include "sampling.hpp"
+#include "report.hpp"
+
+namespace ipc {
+
+// A hot loop registered from outside of this tool, measured with the same methodology as the built-in kernels
+struct BenchmarkCase {
+	std::string op;
+	std::string execution;
+	// Only reported, the case owns its data
+	size_t bufferSize;
+	// How many operations a single call of run performs: rows are per operation
+	size_t opCount;
+	size_t iterationCount = 1 << 8;
+	// Called before every sample, outside of the measured region (e.g. to restore the input data). Optional
+	std::function<void (void)> setup = {};
+	// The measured region, the cost of calling it through std::function is subtracted
+	std::function<void (void)> run;
+};
+
+class Suite
+{
+	std::vector<BenchmarkCase> m_cases;
+
+	static inline constexpr size_t callOverheadIterationCount = 1 << 10;
+
+public:
+	void add(BenchmarkCase benchmarkCase);
+
+	// Median of calling an empty case, on top of what DurationMeasurer already compensates
+	static Duration getCallOverhead(const DurationMeasurer &durationMeasurer);
+
+	// Runs every case in registration order and writes a row per case
+	// Returns per-operation statistics, in registration order
+	std::vector<Statistics> run(const DurationMeasurer &durationMeasurer, const Report &report) const;
+};
+
+// Everything a run needs, in the order it needs it: CPU identification, realtime priority, calibrated measurer and report file
+class Session
+{
+	std::string m_meta;
+	std::string m_cpuInfo;
+	DurationMeasurer m_durationMeasurer;
+	std::ofstream m_output;
+	std::ofstream m_traceOutput;
+	Report m_report;
+
+	static std::string prepareHost(bool realtime);
+
+public:
+	// realtime: raise the process priority before calibrating, which keeps frequency estimations accurate
+	// trace: also write samples to Report::tracePath(reportPath), for the compare mode, at most traceSampleLimit per row
+	Session(const std::string &meta, const std::string &reportPath, bool realtime = true, bool trace = false, size_t traceSampleLimit = Report::defaultTraceSampleLimit);
+
+	Session(const Session &other) = delete;
+	Session& operator=(const Session &other) = delete;
+
+	const std::string& getCPUInfo(void) const {
+		return m_cpuInfo;
+	}
+
+	const DurationMeasurer& getDurationMeasurer(void) const {
+		return m_durationMeasurer;
+	}
+
+	const Report& getReport(void) const {
+		return m_report;
+	}
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace ipc {
+
+// Workers 1..n-1 are threads kept across runs, worker 0 is the calling thread
+// run returns once every worker went through work once, rethrowing the first exception any of them raised
+class ThreadTeam
+{
+	std::vector<std::thread> m_threads;
+	const std::function<void (size_t worker)> *m_work = nullptr;
+	std::exception_ptr m_error;
+	alignas(64) std::atomic<size_t> m_generation{0};
+	alignas(64) std::atomic<size_t> m_doneCount{0};
+	std::atomic<bool> m_failed{false};
+	std::atomic<bool> m_stop{false};
+
+	void runWorker(size_t worker) {
+		try {
+			(*m_work)(worker);
+		} catch (...) {
+			if (!m_failed.exchange(true, std::memory_order_acq_rel))
+				m_error = std::current_exception();
+		}
+	}
+
+public:
+	ThreadTeam(size_t workerCount) {
+		for (size_t i = 1; i < workerCount; i++) {
+			m_threads.emplace_back([this, i]() {
+				size_t seen = 0;
+				while (true) {
+					// Yielding rather than blocking: workers must start together, and may outnumber cores
+					while (m_generation.load(std::memory_order_acquire) == seen)
+						std::this_thread::yield();
+					seen = m_generation.load(std::memory_order_acquire);
+					if (m_stop.load(std::memory_order_acquire))
+						return;
+					runWorker(i);
+					m_doneCount.fetch_add(1, std::memory_order_acq_rel);
+				}
+			});
+		}
+	}
+
+	ThreadTeam(const ThreadTeam &other) = delete;
+	ThreadTeam& operator=(const ThreadTeam &other) = delete;
+
+	size_t getWorkerCount(void) const {
+		return m_threads.size() + 1;
+	}
+
+	void run(const std::function<void (size_t worker)> &work) {
+		m_work = &work;
+		m_doneCount.store(0, std::memory_order_release);
+		m_generation.fetch_add(1, std::memory_order_acq_rel);
+		runWorker(0);
+		while (m_doneCount.load(std::memory_order_acquire) != m_threads.size())
+			std::this_thread::yield();
+
+		if (m_failed.exchange(false, std::memory_order_acq_rel)) {
+			auto error = m_error;
+			m_error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	~ThreadTeam(void) {
+		m_stop.store(true, std::memory_order_release);
+		m_generation.fetch_add(1, std::memory_order_acq_rel);
+		for (auto &thread : m_threads)
+			thread.join();
+	}
+};
+
+}
\ No newline at end of file